@@ -0,0 +1,595 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "cgroup.h"
+#include "eventfs.h"
+
+#include <poll.h>
+#include <sys/inotify.h>
+
+SGLIB_DEFINE_RBTREE_FUNCTIONS( eventfs_cgroup, left, right, color, EVENTFS_CGROUP_CMP );
+
+
+// read a small file into buf, NULL-terminated
+// return 0 on success
+// return -errno on failure
+static int eventfs_cgroup_read_file( char const* path, char* buf, size_t buf_len ) {
+   
+   int rc = 0;
+   ssize_t nr = 0;
+   
+   int fd = open( path, O_RDONLY | O_CLOEXEC );
+   if( fd < 0 ) {
+      return -errno;
+   }
+   
+   nr = pread( fd, buf, buf_len - 1, 0 );
+   rc = -errno;
+   
+   close( fd );
+   
+   if( nr < 0 ) {
+      return rc;
+   }
+   
+   buf[nr] = '\0';
+   return 0;
+}
+
+
+// find the unified-hierarchy cgroup a process is in, from the "0::" line of /proc/<pid>/cgroup
+// return a malloc'ed path on success 
+// return NULL on error, and set *rc to -ENOMEM on OOM, -ENOTSUP if there is no unified hierarchy (or it's the root), or -errno on failure to read it
+static char* eventfs_cgroup_resolve( pid_t pid, int* rc ) {
+   
+   char path[PATH_MAX+1];
+   char buf[EVENTFS_CGROUP_BUF_LEN];
+   char* line = NULL;
+   char* end = NULL;
+   char* cgroup_path = NULL;
+   
+   snprintf( path, PATH_MAX, "/proc/%d/cgroup", (int)pid );
+   
+   *rc = eventfs_cgroup_read_file( path, buf, EVENTFS_CGROUP_BUF_LEN );
+   if( *rc != 0 ) {
+      return NULL;
+   }
+   
+   for( line = buf; line != NULL && *line != '\0'; line = (end != NULL ? end + 1 : NULL) ) {
+      
+      end = strchr( line, '\n' );
+      if( end != NULL ) {
+         *end = '\0';
+      }
+      
+      if( strncmp( line, "0::", 3 ) == 0 ) {
+         
+         if( strcmp( line + 3, "/" ) == 0 ) {
+            
+            // the root cgroup is never empty
+            break;
+         }
+         
+         cgroup_path = strdup( line + 3 );
+         if( cgroup_path == NULL ) {
+            
+            *rc = -ENOMEM;
+            return NULL;
+         }
+         
+         return cgroup_path;
+      }
+   }
+   
+   *rc = -ENOTSUP;
+   return NULL;
+}
+
+
+// is a cgroup still populated, according to its cgroup.events?
+// return 1 if so
+// return 0 if not (or if it's gone)
+// return -errno on failure to read it
+static int eventfs_cgroup_read_populated( char const* cgroup_path ) {
+   
+   int rc = 0;
+   char path[PATH_MAX+1];
+   char buf[EVENTFS_CGROUP_BUF_LEN];
+   char* populated = NULL;
+   
+   snprintf( path, PATH_MAX, "%s%s/cgroup.events", EVENTFS_CGROUP_ROOT, cgroup_path );
+   
+   rc = eventfs_cgroup_read_file( path, buf, EVENTFS_CGROUP_BUF_LEN );
+   if( rc != 0 ) {
+      return (rc == -ENOENT ? 0 : rc);
+   }
+   
+   populated = strstr( buf, "populated " );
+   if( populated == NULL ) {
+      return -EIO;
+   }
+   
+   return (populated[ strlen("populated ") ] == '0' ? 0 : 1);
+}
+
+
+// mark a cgroup as empty, and take it out of the table so the next get makes a new entry.
+// return a malloc'ed, NULL-terminated list of the paths of its directories, to be reaped once the lock is dropped
+// return NULL on OOM, in which case the caller should sweep
+// NOTE: table->lock must be held
+static char** eventfs_cgroup_emptied( struct eventfs_cgroup_table* table, eventfs_cgroup* cgroup ) {
+   
+   char** dir_paths = NULL;
+   size_t num_dirs = 0;
+   
+   eventfs_debug("cgroup '%s' is empty\n", cgroup->path );
+   __atomic_store_n( &cgroup->populated, false, __ATOMIC_SEQ_CST );
+   
+   if( !cgroup->detached ) {
+      
+      sglib_eventfs_cgroup_delete( &table->cgroups, cgroup );
+      
+      if( table->fd >= 0 && cgroup->wd >= 0 ) {
+         inotify_rm_watch( table->fd, cgroup->wd );
+      }
+      
+      cgroup->wd = -1;
+      cgroup->detached = true;
+   }
+   
+   for( struct eventfs_dir_inode* dir = cgroup->dirs; dir != NULL; dir = dir->cgroup_next ) {
+      num_dirs++;
+   }
+   
+   dir_paths = EVENTFS_CALLOC( char*, num_dirs + 1 );
+   if( dir_paths != NULL ) {
+      
+      size_t i = 0;
+      for( struct eventfs_dir_inode* dir = cgroup->dirs; dir != NULL; dir = dir->cgroup_next ) {
+         
+         // if this fails, the next sweep gets it
+         dir_paths[i] = strdup( dir->path );
+         if( dir_paths[i] != NULL ) {
+            i++;
+         }
+      }
+   }
+   
+   return dir_paths;
+}
+
+
+// reap the directories of a cgroup that just emptied
+static void eventfs_cgroup_reap( struct eventfs_cgroup_table* table, char** dir_paths ) {
+   
+   int rc = 0;
+   
+   if( dir_paths == NULL ) {
+      
+      // OOM; find them the slow way 
+      eventfs_deferred_reap( table->eventfs );
+      return;
+   }
+   
+   for( int i = 0; dir_paths[i] != NULL; i++ ) {
+      
+      rc = eventfs_dir_reap( table->eventfs, dir_paths[i] );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_dir_reap('%s') rc = %d\n", dir_paths[i], rc );
+      }
+      
+      eventfs_safe_free( dir_paths[i] );
+   }
+   
+   eventfs_safe_free( dir_paths );
+}
+
+
+// reap the directories of every cgroup whose watch fired and which is now empty.
+// cgroup.events is read without the table lock, holding a reference so the entry stays put.
+static void eventfs_cgroup_events( struct eventfs_cgroup_table* table, int wd, bool removed ) {
+   
+   int rc = 0;
+   uint64_t generation = 0;
+   char** dir_paths = NULL;
+   eventfs_cgroup* cgroup = NULL;
+   struct sglib_eventfs_cgroup_iterator itr;
+   
+   pthread_mutex_lock( &table->lock );
+   
+   for( cgroup = sglib_eventfs_cgroup_it_init( &itr, table->cgroups ); cgroup != NULL; cgroup = sglib_eventfs_cgroup_it_next( &itr ) ) {
+      
+      if( cgroup->wd == wd ) {
+         break;
+      }
+   }
+   
+   if( cgroup == NULL ) {
+      
+      // not ours anymore
+      pthread_mutex_unlock( &table->lock );
+      return;
+   }
+   
+   if( removed ) {
+      
+      // the kernel dropped the watch, because the cgroup is gone 
+      cgroup->wd = -1;
+      dir_paths = eventfs_cgroup_emptied( table, cgroup );
+      
+      pthread_mutex_unlock( &table->lock );
+      
+      eventfs_cgroup_reap( table, dir_paths );
+      return;
+   }
+   
+   cgroup->refcount++;
+   generation = cgroup->generation;
+   
+   pthread_mutex_unlock( &table->lock );
+   
+   rc = eventfs_cgroup_read_populated( cgroup->path );
+   
+   pthread_mutex_lock( &table->lock );
+   
+   // a process that bound to it since we read cgroup.events was in it, so our read may be stale;
+   // if it has since emptied, that fires the watch again.
+   if( rc == 0 && !cgroup->detached && cgroup->generation == generation ) {
+      
+      dir_paths = eventfs_cgroup_emptied( table, cgroup );
+   }
+   else {
+      
+      // still populated, or we can't tell
+      rc = 1;
+   }
+   
+   pthread_mutex_unlock( &table->lock );
+   
+   if( rc == 0 ) {
+      eventfs_cgroup_reap( table, dir_paths );
+   }
+   
+   eventfs_cgroup_put( table, cgroup );
+}
+
+
+// watcher thread: wait for cgroup.events to change
+static void* eventfs_cgroup_main( void* arg ) {
+   
+   struct eventfs_cgroup_table* table = (struct eventfs_cgroup_table*)arg;
+   char buf[ EVENTFS_CGROUP_EVENT_BUF_LEN ] __attribute__((aligned(__alignof__(struct inotify_event))));
+   struct pollfd pfd;
+   ssize_t len = 0;
+   int rc = 0;
+   
+   while( table->running ) {
+      
+      pfd.fd = table->fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      
+      // wake up once a tick, so we can be stopped 
+      rc = poll( &pfd, 1, EVENTFS_TIMER_TICK_MS );
+      if( rc <= 0 ) {
+         continue;
+      }
+      
+      len = read( table->fd, buf, EVENTFS_CGROUP_EVENT_BUF_LEN );
+      if( len <= 0 ) {
+         continue;
+      }
+      
+      for( char* p = buf; p < buf + len; ) {
+         
+         struct inotify_event* ev = (struct inotify_event*)p;
+         
+         if( ev->mask & IN_Q_OVERFLOW ) {
+            
+            // lost events
+            eventfs_deferred_reap( table->eventfs );
+         }
+         else if( ev->mask & (IN_MODIFY | IN_IGNORED) ) {
+            
+            eventfs_cgroup_events( table, ev->wd, (ev->mask & IN_IGNORED) != 0 );
+         }
+         
+         p += sizeof(struct inotify_event) + ev->len;
+      }
+   }
+   
+   return NULL;
+}
+
+
+// set up an (unwatched) cgroup table
+// return 0 on success 
+// return -errno on failure to set up the lock
+int eventfs_cgroup_table_init( struct eventfs_cgroup_table* table, struct eventfs_state* eventfs ) {
+   
+   int rc = 0;
+   
+   memset( table, 0, sizeof(struct eventfs_cgroup_table) );
+   table->eventfs = eventfs;
+   table->fd = -1;
+   
+   rc = pthread_mutex_init( &table->lock, NULL );
+   if( rc != 0 ) {
+      return -rc;
+   }
+   
+   return 0;
+}
+
+
+// free a cgroup table.  Every directory must have put its cgroup by now.
+// always succeeds
+int eventfs_cgroup_table_free( struct eventfs_cgroup_table* table ) {
+   
+   pthread_mutex_destroy( &table->lock );
+   return 0;
+}
+
+
+// start watching cgroups
+// return 0 on success
+// return -errno on failure to set up inotify or start the thread
+int eventfs_cgroup_table_start( struct eventfs_cgroup_table* table ) {
+   
+   int rc = 0;
+   
+   table->fd = inotify_init1( IN_CLOEXEC | IN_NONBLOCK );
+   if( table->fd < 0 ) {
+      
+      rc = -errno;
+      table->fd = -1;
+      return rc;
+   }
+   
+   table->running = true;
+   
+   rc = pthread_create( &table->thread, NULL, eventfs_cgroup_main, table );
+   if( rc != 0 ) {
+      
+      table->running = false;
+      close( table->fd );
+      table->fd = -1;
+      
+      return -rc;
+   }
+   
+   return 0;
+}
+
+
+// stop watching cgroups.
+// directories may still point to entries, so those are kept until they are put.
+// always succeeds
+int eventfs_cgroup_table_stop( struct eventfs_cgroup_table* table ) {
+   
+   if( table->fd < 0 ) {
+      return 0;
+   }
+   
+   table->running = false;
+   pthread_join( table->thread, NULL );
+   
+   pthread_mutex_lock( &table->lock );
+   
+   close( table->fd );
+   table->fd = -1;
+   
+   pthread_mutex_unlock( &table->lock );
+   return 0;
+}
+
+
+// bind to the cgroup a process is in, and take a reference to it.
+// the first directory in a cgroup sets up the watch on its cgroup.events.
+// a cgroup that emptied out has already left the table, so a refilled or recreated cgroup gets a fresh entry.
+// return the cgroup on success, with *rc set to 0
+// return NULL on error, with *rc set to:
+// * -ENOMEM on OOM 
+// * -ENOTSUP if the process is not in a cgroup we can watch
+// * -EAGAIN if we are not watching cgroups
+// * -errno on failure to read the process's cgroup, or to watch it
+eventfs_cgroup* eventfs_cgroup_get( struct eventfs_cgroup_table* table, pid_t pid, int* rc ) {
+   
+   char events_path[PATH_MAX+1];
+   char** dir_paths = NULL;
+   eventfs_cgroup* member = NULL;
+   eventfs_cgroup lookup;
+   int populated = 0;
+   uint64_t generation = 0;
+   
+   char* cgroup_path = eventfs_cgroup_resolve( pid, rc );
+   if( cgroup_path == NULL ) {
+      return NULL;
+   }
+   
+   memset( &lookup, 0, sizeof(eventfs_cgroup) );
+   lookup.path = cgroup_path;
+   
+   pthread_mutex_lock( &table->lock );
+   
+   if( table->fd < 0 ) {
+      
+      pthread_mutex_unlock( &table->lock );
+      
+      eventfs_safe_free( cgroup_path );
+      *rc = -EAGAIN;
+      return NULL;
+   }
+   
+   member = sglib_eventfs_cgroup_find_member( table->cgroups, &lookup );
+   if( member != NULL ) {
+      
+      // already watched
+      member->refcount++;
+      member->generation++;
+      pthread_mutex_unlock( &table->lock );
+      
+      eventfs_safe_free( cgroup_path );
+      *rc = 0;
+      return member;
+   }
+   
+   member = EVENTFS_CALLOC( eventfs_cgroup, 1 );
+   if( member == NULL ) {
+      
+      pthread_mutex_unlock( &table->lock );
+      
+      eventfs_safe_free( cgroup_path );
+      *rc = -ENOMEM;
+      return NULL;
+   }
+   
+   snprintf( events_path, PATH_MAX, "%s%s/cgroup.events", EVENTFS_CGROUP_ROOT, cgroup_path );
+   
+   member->wd = inotify_add_watch( table->fd, events_path, IN_MODIFY );
+   if( member->wd < 0 ) {
+      
+      *rc = -errno;
+      pthread_mutex_unlock( &table->lock );
+      
+      eventfs_safe_free( member );
+      eventfs_safe_free( cgroup_path );
+      return NULL;
+   }
+   
+   member->path = cgroup_path;
+   member->refcount = 1;
+   member->populated = true;
+   
+   sglib_eventfs_cgroup_add( &table->cgroups, member );
+   
+   generation = member->generation;
+   
+   pthread_mutex_unlock( &table->lock );
+   
+   // it may have emptied out before we started watching 
+   populated = eventfs_cgroup_read_populated( cgroup_path );
+   if( populated == 0 ) {
+      
+      pthread_mutex_lock( &table->lock );
+      
+      if( !member->detached && member->generation == generation ) {
+         dir_paths = eventfs_cgroup_emptied( table, member );
+      }
+      
+      pthread_mutex_unlock( &table->lock );
+      
+      // no directories are bound to it yet
+      if( dir_paths != NULL ) {
+         eventfs_cgroup_reap( table, dir_paths );
+      }
+   }
+   
+   *rc = 0;
+   return member;
+}
+
+
+// release a reference to a cgroup, and stop watching it once no directory points to it
+void eventfs_cgroup_put( struct eventfs_cgroup_table* table, eventfs_cgroup* cgroup ) {
+   
+   pthread_mutex_lock( &table->lock );
+   
+   cgroup->refcount--;
+   if( cgroup->refcount > 0 ) {
+      
+      pthread_mutex_unlock( &table->lock );
+      return;
+   }
+   
+   if( !cgroup->detached ) {
+      
+      sglib_eventfs_cgroup_delete( &table->cgroups, cgroup );
+      
+      if( table->fd >= 0 && cgroup->wd >= 0 ) {
+         inotify_rm_watch( table->fd, cgroup->wd );
+      }
+   }
+   
+   pthread_mutex_unlock( &table->lock );
+   
+   eventfs_safe_free( cgroup->path );
+   eventfs_safe_free( cgroup );
+}
+
+
+// does a cgroup still have processes in it?
+bool eventfs_cgroup_is_populated( eventfs_cgroup* cgroup ) {
+   
+   return __atomic_load_n( &cgroup->populated, __ATOMIC_SEQ_CST );
+}
+
+
+// bind a directory to a cgroup, so it can be found once the cgroup empties
+// always succeeds
+// NOTE: dir->path must be set, and dir must not already be bound
+int eventfs_cgroup_add_dir( struct eventfs_cgroup_table* table, eventfs_cgroup* cgroup, struct eventfs_dir_inode* dir ) {
+   
+   pthread_mutex_lock( &table->lock );
+   
+   dir->cgroup_prev = NULL;
+   dir->cgroup_next = cgroup->dirs;
+   
+   if( cgroup->dirs != NULL ) {
+      cgroup->dirs->cgroup_prev = dir;
+   }
+   
+   cgroup->dirs = dir;
+   dir->cgroup_indexed = true;
+   
+   pthread_mutex_unlock( &table->lock );
+   return 0;
+}
+
+
+// unbind a directory from its cgroup, if it is bound
+// always succeeds
+int eventfs_cgroup_remove_dir( struct eventfs_cgroup_table* table, eventfs_cgroup* cgroup, struct eventfs_dir_inode* dir ) {
+   
+   pthread_mutex_lock( &table->lock );
+   
+   if( dir->cgroup_indexed ) {
+      
+      if( dir->cgroup_prev != NULL ) {
+         dir->cgroup_prev->cgroup_next = dir->cgroup_next;
+      }
+      else {
+         cgroup->dirs = dir->cgroup_next;
+      }
+      
+      if( dir->cgroup_next != NULL ) {
+         dir->cgroup_next->cgroup_prev = dir->cgroup_prev;
+      }
+      
+      dir->cgroup_prev = NULL;
+      dir->cgroup_next = NULL;
+      dir->cgroup_indexed = false;
+   }
+   
+   pthread_mutex_unlock( &table->lock );
+   return 0;
+}
@@ -0,0 +1,93 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _EVENTFS_CGROUP_H_
+#define _EVENTFS_CGROUP_H_
+
+#include "os.h"
+#include "util.h"
+#include "sglib.h"
+
+// where the (unified) cgroup hierarchy is mounted
+#define EVENTFS_CGROUP_ROOT             "/sys/fs/cgroup"
+
+// buffer sizes for /proc/<pid>/cgroup and cgroup.events
+#define EVENTFS_CGROUP_BUF_LEN          4096
+
+// receive buffer for inotify events
+#define EVENTFS_CGROUP_EVENT_BUF_LEN    4096
+
+struct eventfs_state;
+struct eventfs_dir_inode;
+
+// a cgroup that directories share fate with.
+// there is one of these per cgroup, with one inotify watch on its cgroup.events, however many directories it has.
+// once a cgroup empties, its entry leaves the table (but lives on until its directories put it), so a process
+// in a refilled or recreated cgroup of the same name gets a fresh entry.
+struct eventfs_cgroup_entry {
+   
+   char* path;                          // path under EVENTFS_CGROUP_ROOT, e.g. /system.slice/foo.service
+   int wd;                              // inotify watch on its cgroup.events
+   int refcount;                        // number of directories pointing here
+   bool populated;                      // if false, then every process in it has exited (read without the lock)
+   bool detached;                       // if true, it emptied out and is no longer in the table or watched
+   uint64_t generation;                 // bumped on every get, so a stale cgroup.events read can be detected
+   struct eventfs_dir_inode* dirs;      // directories bound to it
+   
+   // rb tree 
+   int color;
+   struct eventfs_cgroup_entry* left;
+   struct eventfs_cgroup_entry* right;
+};
+
+typedef struct eventfs_cgroup_entry eventfs_cgroup;
+
+#define EVENTFS_CGROUP_CMP( c1, c2 ) (strcmp( (c1)->path, (c2)->path ))
+
+SGLIB_DEFINE_RBTREE_PROTOTYPES( eventfs_cgroup, left, right, color, EVENTFS_CGROUP_CMP );
+
+// all watched cgroups, and the thread that watches them.
+// everything but each cgroup's populated flag is guarded by lock.
+struct eventfs_cgroup_table {
+   
+   pthread_mutex_t lock;
+   eventfs_cgroup* cgroups;
+   
+   int fd;                              // inotify descriptor (-1 if not watching)
+   pthread_t thread;
+   volatile bool running;
+   
+   struct eventfs_state* eventfs;
+};
+
+int eventfs_cgroup_table_init( struct eventfs_cgroup_table* table, struct eventfs_state* eventfs );
+int eventfs_cgroup_table_free( struct eventfs_cgroup_table* table );
+int eventfs_cgroup_table_start( struct eventfs_cgroup_table* table );
+int eventfs_cgroup_table_stop( struct eventfs_cgroup_table* table );
+
+eventfs_cgroup* eventfs_cgroup_get( struct eventfs_cgroup_table* table, pid_t pid, int* rc );
+void eventfs_cgroup_put( struct eventfs_cgroup_table* table, eventfs_cgroup* cgroup );
+bool eventfs_cgroup_is_populated( eventfs_cgroup* cgroup );
+
+int eventfs_cgroup_add_dir( struct eventfs_cgroup_table* table, eventfs_cgroup* cgroup, struct eventfs_dir_inode* dir );
+int eventfs_cgroup_remove_dir( struct eventfs_cgroup_table* table, eventfs_cgroup* cgroup, struct eventfs_dir_inode* dir );
+
+#endif
@@ -239,6 +239,80 @@ static int eventfs_ini_config_parser( void* userdata, char const* section, char
             }
         }
         
+        else if( strcmp(name, EVENTFS_JOURNAL_PATH) == 0 ) {
+            
+            // journal file 
+            char* tmp = strdup( value );
+            if( tmp == NULL ) {
+                
+                // OOM 
+                return 0;
+            }
+            else {
+                
+                eventfs_safe_free( config->journal_path );
+                config->journal_path = tmp;
+                return 1;
+            }
+        }
+        
+        else if( strcmp(name, EVENTFS_SNAPSHOT_PATH) == 0 ) {
+            
+            // snapshot file 
+            char* tmp = strdup( value );
+            if( tmp == NULL ) {
+                
+                // OOM 
+                return 0;
+            }
+            else {
+                
+                eventfs_safe_free( config->snapshot_path );
+                config->snapshot_path = tmp;
+                return 1;
+            }
+        }
+        
+        else if( strcmp(name, EVENTFS_VERIFY) == 0 ) {
+            
+            // liveness check for new directories
+            if( strcmp(value, EVENTFS_VERIFY_NAME_FAST) == 0 ) {
+                
+                config->verify_fast = true;
+                return 1;
+            }
+            else if( strcmp(value, EVENTFS_VERIFY_NAME_FULL) == 0 ) {
+                
+                config->verify_fast = false;
+                return 1;
+            }
+            else {
+                
+                eventfs_error("Invalid value '%s' for '%s'\n", value, name );
+                return 0;
+            }
+        }
+        
+        else if( strcmp(name, EVENTFS_FATE) == 0 ) {
+            
+            // what new directories share fate with
+            if( strcmp(value, EVENTFS_FATE_NAME_CGROUP) == 0 ) {
+                
+                config->fate_cgroup = true;
+                return 1;
+            }
+            else if( strcmp(value, EVENTFS_FATE_NAME_PROCESS) == 0 ) {
+                
+                config->fate_cgroup = false;
+                return 1;
+            }
+            else {
+                
+                eventfs_error("Invalid value '%s' for '%s'\n", value, name );
+                return 0;
+            }
+        }
+        
         else {
             
             // unknown 
@@ -664,6 +738,16 @@ int eventfs_config_free( struct eventfs_config* conf ) {
         eventfs_safe_free( conf->quotas_dir );
     }
     
+    if( conf->journal_path != NULL ) {
+        
+        eventfs_safe_free( conf->journal_path );
+    }
+    
+    if( conf->snapshot_path != NULL ) {
+        
+        eventfs_safe_free( conf->snapshot_path );
+    }
+    
     memset( conf, 0, sizeof(struct eventfs_config) );
     return 0;
 }
@@ -34,6 +34,18 @@
 #define EVENTFS_DEFAULT_DIR_SIZE        "default_max_files_per_dir"
 #define EVENTFS_DEFAULT_MAX_BYTES       "default_max_bytes"
 #define EVENTFS_QUOTAS_DIR              "quotas"
+#define EVENTFS_JOURNAL_PATH            "journal"
+#define EVENTFS_SNAPSHOT_PATH           "snapshot"
+#define EVENTFS_VERIFY                  "verify"
+#define EVENTFS_FATE                    "fate"
+
+// how thoroughly to check that a directory's creator is still alive (global "verify" key, or a directory's user.eventfs_verify xattr)
+#define EVENTFS_VERIFY_NAME_FULL        "full"          // binary inode, size, modtime, and start time (the default)
+#define EVENTFS_VERIFY_NAME_FAST        "fast"          // start time only
+
+// what a directory shares fate with (global "fate" key)
+#define EVENTFS_FATE_NAME_PROCESS       "process"       // the thread that created it (the default)
+#define EVENTFS_FATE_NAME_CGROUP        "cgroup"        // the cgroup its creator was in
 
 // quota file
 #define EVENTFS_QUOTA_CONFIG            "eventfs-quota"
@@ -55,6 +67,12 @@ struct eventfs_config {
     uint64_t default_bytes_quota;
     
     char* quotas_dir;
+    
+    char* journal_path;         // (optional) write-ahead journal for sticky directories
+    char* snapshot_path;        // (optional) image of all directories, written on shutdown and restored on startup
+    
+    bool verify_fast;           // if true, then new directories only have their creator's start time checked
+    bool fate_cgroup;           // if true, then new directories go away once their creator's cgroup is empty, instead of when their creator exits
 };
 
 int eventfs_config_load( char const* path, struct eventfs_config* conf, struct eventfs_quota_entry** user_quotas, struct eventfs_quota_entry** group_quotas );
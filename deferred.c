@@ -22,12 +22,17 @@
 #include "deferred.h"
 #include "eventfs.h"
 
+#include <sys/wait.h>
+
 // deferred remove-all context
 struct eventfs_deferred_remove_ctx {
 
+   struct eventfs_state* eventfs;
    struct fskit_core* core;
    char* fs_path;               // path to the entry to remove
    fskit_entry_set* children;   // the (optional) children to remove (not yet garbage-collected)
+   struct eventfs_dir_inode* dir;       // dead directory whose files are still being unlinked (NULL if not a directory)
+   bool moved;                          // if true, then dir has been moved to its EVENTFS_REAPED_PREFIX name (or could not be)
 };
 
 
@@ -81,8 +86,224 @@ static int eventfs_deferred_remove_cb( struct eventfs_wreq* wreq, void* cls ) {
 }
 
 
+// move a dead directory out of the way before unlinking its files: detach it from its name, so a new directory can take that name
+// right away, and re-attach it under a reserved EVENTFS_REAPED_PREFIX name, so its files can still be unlinked by path.
+// it is already flagged deleted, so it is left out of listings and can't be stat'ed under either name.
+// return 0 on success, and point ctx->fs_path at the new name 
+// return -ENOENT if it is gone, or not ours anymore 
+// return -ENOMEM on OOM
+static int eventfs_deferred_move_aside( struct eventfs_deferred_remove_ctx* ctx ) {
+   
+   int rc = 0;
+   struct fskit_entry* root = NULL;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   char* reaped_path = NULL;
+   char name[FSKIT_FILESYSTEM_NAMEMAX+1];
+   char reaped_name[FSKIT_FILESYSTEM_NAMEMAX+1];
+   
+   memset( name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+   memset( reaped_name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+   
+   fskit_basename( ctx->fs_path, name );
+   
+   // NOTE: lock order is root, then directory
+   root = fskit_entry_resolve_path( ctx->core, "/", 0, 0, true, &rc );
+   if( root == NULL ) {
+      return rc;
+   }
+   
+   dent = fskit_dir_find_by_name( root, name );
+   if( dent == NULL ) {
+      
+      fskit_entry_unlock( root );
+      return -ENOENT;
+   }
+   
+   fskit_entry_wlock( dent );
+   
+   dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   if( dir == NULL || dir != ctx->dir || !dir->deleted ) {
+      
+      fskit_entry_unlock( dent );
+      fskit_entry_unlock( root );
+      return -ENOENT;
+   }
+   
+   // generations are never reused, so neither is this name
+   snprintf( reaped_name, FSKIT_FILESYSTEM_NAMEMAX, EVENTFS_REAPED_PREFIX "%" PRIu64, dir->generation );
+   
+   reaped_path = fskit_fullpath( "/", reaped_name, NULL );
+   if( reaped_path == NULL ) {
+      
+      fskit_entry_unlock( dent );
+      fskit_entry_unlock( root );
+      return -ENOMEM;
+   }
+   
+   rc = fskit_entry_detach_lowlevel( root, name );
+   if( rc == 0 ) {
+      
+      rc = fskit_entry_attach_lowlevel( root, dent, reaped_name );
+      if( rc != 0 ) {
+         
+         // put it back 
+         fskit_entry_attach_lowlevel( root, dent, name );
+      }
+   }
+   
+   if( rc == 0 ) {
+      
+      // the journal only knows it by its old name, so remove it under that one 
+      eventfs_journal_log_rmdir( ctx->eventfs, ctx->fs_path, dir );
+      dir->journaled = false;
+   }
+   
+   fskit_entry_unlock( dent );
+   fskit_entry_unlock( root );
+   
+   if( rc != 0 ) {
+      
+      eventfs_safe_free( reaped_path );
+      return rc;
+   }
+   
+   eventfs_debug("DEFERRED: moved '%s' to '%s'\n", ctx->fs_path, reaped_path );
+   
+   eventfs_safe_free( ctx->fs_path );
+   ctx->fs_path = reaped_path;
+   return 0;
+}
+
+
+// helper to unlink the next batch of a dead directory's files.
+// the first time, the directory is moved out of the way so its name is free again.
+// once they're all gone, garbage-collect what's left (head, tail, .push, cursors) in one go.
+// between batches, go to the back of the queue so other deferred work gets a turn.
+static int eventfs_deferred_drain_cb( struct eventfs_wreq* wreq, void* cls ) {
+   
+   int rc = 0;
+   struct eventfs_deferred_remove_ctx* ctx = (struct eventfs_deferred_remove_ctx*)cls;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   struct eventfs_file_deque* batch = NULL;
+   struct eventfs_wreq* work = NULL;
+   struct eventfs_caller caller;
+   int num_unlinked = 0;
+   
+   if( !ctx->moved ) {
+      
+      ctx->moved = true;
+      
+      rc = eventfs_deferred_move_aside( ctx );
+      if( rc == -ENOENT ) {
+         
+         // already gone, or not ours anymore 
+         eventfs_safe_free( ctx->fs_path );
+         eventfs_safe_free( ctx );
+         return 0;
+      }
+      else if( rc != 0 ) {
+         
+         // drain it where it is; its name is only busy until then
+         eventfs_error("eventfs_deferred_move_aside('%s') rc = %d\n", ctx->fs_path, rc );
+      }
+   }
+   
+   while( true ) {
+      
+      num_unlinked = 0;
+      
+      dent = fskit_entry_resolve_path( ctx->core, ctx->fs_path, 0, 0, true, &rc );
+      if( dent == NULL ) {
+         
+         // already gone 
+         eventfs_safe_free( ctx->fs_path );
+         eventfs_safe_free( ctx );
+         return 0;
+      }
+      
+      dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+      if( dir == NULL || dir != ctx->dir || !dir->deleted ) {
+         
+         // not ours anymore
+         fskit_entry_unlock( dent );
+         
+         eventfs_safe_free( ctx->fs_path );
+         eventfs_safe_free( ctx );
+         return 0;
+      }
+      
+      batch = eventfs_dir_inode_drain( dir, EVENTFS_GC_BATCH );
+      if( batch == NULL ) {
+         
+         // all files are gone; only a handful of entries are left
+         rc = fskit_entry_tag_garbage( dent, &ctx->children );
+         fskit_entry_unlock( dent );
+         
+         if( rc != 0 ) {
+            
+            eventfs_error("fskit_entry_garbage_collect('%s') rc = %d\n", ctx->fs_path, rc );
+            
+            eventfs_safe_free( ctx->fs_path );
+            eventfs_safe_free( ctx );
+            return rc;
+         }
+         
+         return eventfs_deferred_remove_cb( wreq, ctx );
+      }
+      
+      fskit_entry_unlock( dent );
+      
+      // unlink them as eventfs itself
+      caller.pid = getpid();
+      caller.uid = 0;
+      caller.gid = 0;
+      eventfs_caller_set( &caller );
+      
+      for( struct eventfs_file_deque* itr = batch; itr != NULL; ) {
+         
+         struct eventfs_file_deque* old_itr = itr;
+         itr = itr->next;
+         
+         char* child_path = fskit_fullpath( ctx->fs_path, old_itr->name, NULL );
+         if( child_path != NULL ) {
+            
+            rc = fskit_unlink( ctx->core, child_path, 0, 0 );
+            if( rc != 0 && rc != -ENOENT ) {
+               
+               eventfs_error("fskit_unlink('%s') rc = %d\n", child_path, rc );
+            }
+            
+            eventfs_safe_free( child_path );
+         }
+         
+         // released as we go
+         eventfs_safe_free( old_itr );
+         num_unlinked++;
+      }
+      
+      eventfs_caller_set( NULL );
+      
+      eventfs_debug("DEFERRED: unlinked %d files from '%s'\n", num_unlinked, ctx->fs_path );
+      
+      // yield
+      work = EVENTFS_CALLOC( struct eventfs_wreq, 1 );
+      if( work != NULL ) {
+         
+         eventfs_wreq_init( work, eventfs_deferred_drain_cb, ctx );
+         eventfs_wq_add( ctx->eventfs->deferred_wq, work );
+         return 0;
+      }
+      
+      // OOM; keep going without yielding, rather than leave it half-collected
+   }
+}
+
+
 // Garbage-collect the given inode, and queue it for unlinkage.
-// If the inode is a directory, recursively garbage-collect its children as well, and queue them and their descendents for unlinkage
+// If the inode is a directory, its files are unlinked EVENTFS_GC_BATCH at a time on deferred_wq, and then the directory and 
+// whatever else is in it are garbage-collected and unlinked.  This way, no single piece of deferred work is proportional to the directory's size.
 // return 0 on success
 // NOTE: child must be write-locked
 int eventfs_deferred_remove( struct eventfs_state* eventfs, char const* child_path, struct fskit_entry* child ) {
@@ -107,6 +328,7 @@ int eventfs_deferred_remove( struct eventfs_state* eventfs, char const* child_pa
    }
    
    // set up the deferred unlink request 
+   ctx->eventfs = eventfs;
    ctx->core = core;
    ctx->fs_path = strdup( child_path );
    
@@ -117,6 +339,17 @@ int eventfs_deferred_remove( struct eventfs_state* eventfs, char const* child_pa
        return -ENOMEM;
    }
    
+   if( fskit_entry_get_type( child ) == FSKIT_ENTRY_TYPE_DIR && fskit_entry_get_user_data( child ) != NULL ) {
+       
+       // drain it a batch at a time, instead of collecting all of its children now
+       ctx->dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( child );
+       
+       eventfs_wreq_init( work, eventfs_deferred_drain_cb, ctx );
+       eventfs_wq_add( eventfs->deferred_wq, work );
+       
+       return 0;
+   }
+   
    // garbage-collect this child
    rc = fskit_entry_tag_garbage( child, &children );
    if( rc != 0 ) {
@@ -138,15 +371,63 @@ int eventfs_deferred_remove( struct eventfs_state* eventfs, char const* child_pa
 }
 
 
-// callback to sweep the filesystem to remove dead directory inodes.
+static int eventfs_deferred_reap_timer_cb( struct eventfs_timer* timer, void* cls );
+
+// set up the sweep scheduler.
+// the first sweep may run right away.
+// return 0 on success 
+// return negative on failure to set up the lock
+int eventfs_reaper_init( struct eventfs_reaper* reaper, struct eventfs_state* eventfs ) {
+   
+   int rc = 0;
+   
+   memset( reaper, 0, sizeof(struct eventfs_reaper) );
+   
+   rc = pthread_mutex_init( &reaper->lock, NULL );
+   if( rc != 0 ) {
+      return -rc;
+   }
+   
+   reaper->eventfs = eventfs;
+   reaper->interval = EVENTFS_REAP_INTERVAL_MIN;
+   reaper->next_sweep = eventfs_timer_now();
+   reaper->last_sweep = reaper->next_sweep;
+   
+   eventfs_timer_init( &reaper->timer, eventfs_deferred_reap_timer_cb, NULL, reaper );
+   
+   return 0;
+}
+
+
+// free the sweep scheduler.
+// the timer wheel and deferred_wq must already be stopped.
+int eventfs_reaper_free( struct eventfs_reaper* reaper ) {
+   
+   if( reaper->child > 0 ) {
+      
+      // collect the last sweep, if it's done
+      waitpid( reaper->child, NULL, WNOHANG );
+   }
+   
+   pthread_mutex_destroy( &reaper->lock );
+   memset( reaper, 0, sizeof(struct eventfs_reaper) );
+   return 0;
+}
+
+
+// sweep the filesystem to remove dead directory inodes.
 // basically, just run `ls` on the mountpoint.  The readdir() callback will queue
-// dead directories for garbage-collection.
+// dead directories for garbage-collection, and report how many it found.
+// runs on deferred_wq, either as a queued request or from the timer wheel.
 // return 0 on success
-static int eventfs_deferred_reap_cb( struct eventfs_wreq* wreq, void* cls ) {
+static int eventfs_deferred_sweep( struct eventfs_reaper* reaper ) {
     
     int rc = 0;
     int status = 0;
-    char* const mountpoint = (char* const)cls;
+    char* const mountpoint = reaper->eventfs->mountpoint;
+    uint64_t now = eventfs_timer_now();
+    uint64_t found = 0;
+    bool again = false;
     
     char* const argv[] = {
         "/bin/ls", 
@@ -158,6 +439,55 @@ static int eventfs_deferred_reap_cb( struct eventfs_wreq* wreq, void* cls ) {
         NULL
     };
     
+    pthread_mutex_lock( &reaper->lock );
+    
+    if( reaper->child > 0 ) {
+        
+        // we reap our own sweeps, so the last one's pid can't have been reused yet
+        rc = waitpid( reaper->child, &status, WNOHANG );
+        if( rc == 0 ) {
+            
+            // last sweep is still going.
+            // try again next tick; anyone else who asks in the meantime is coalesced into this.
+            eventfs_timer_schedule( &reaper->eventfs->timers, &reaper->timer, now + 1 );
+            pthread_mutex_unlock( &reaper->lock );
+            return 0;
+        }
+        
+        rc = 0;
+    }
+    
+    reaper->queued = false;
+    reaper->child = 0;
+    __atomic_store_n( &reaper->last_sweep, now, __ATOMIC_SEQ_CST );
+    
+    // whatever sweeps and listings found since the last sweep started tells us how fast things are dying
+    found = __atomic_exchange_n( &reaper->found, 0, __ATOMIC_SEQ_CST );
+    if( found == 0 ) {
+        
+        // nothing is dying; back off 
+        reaper->interval = (reaper->interval * 2 < EVENTFS_REAP_INTERVAL_MAX ? reaper->interval * 2 : EVENTFS_REAP_INTERVAL_MAX);
+    }
+    else {
+        
+        // things are dying; keep sweeping, and sooner
+        reaper->interval = (reaper->interval / 2 > EVENTFS_REAP_INTERVAL_MIN ? reaper->interval / 2 : EVENTFS_REAP_INTERVAL_MIN);
+        again = true;
+    }
+    
+    __atomic_store_n( &reaper->next_sweep, now + reaper->interval, __ATOMIC_SEQ_CST );
+    
+    if( again ) {
+        
+        // follow up on our own, without waiting to be asked
+        reaper->queued = true;
+        eventfs_timer_schedule( &reaper->eventfs->timers, &reaper->timer, now + reaper->interval );
+    }
+    
+    pthread_mutex_unlock( &reaper->lock );
+    
+    eventfs_debug("DEFERRED: sweep (found %" PRIu64 " since last; next in %" PRIu64 " ticks)\n", found, reaper->interval );
+    
     // send child's output to NULL
     int devnull = open("/dev/null", O_WRONLY );
     if( devnull < 0 ) {
@@ -193,26 +523,160 @@ static int eventfs_deferred_reap_cb( struct eventfs_wreq* wreq, void* cls ) {
         
         close( devnull );
         
-        // explicitly set SIGCHLD to SIG_IDN, so the kernel should reap it
+        // the next sweep reaps it
+        pthread_mutex_lock( &reaper->lock );
+        reaper->child = child;
+        pthread_mutex_unlock( &reaper->lock );
+        
         return 0;
     }
 }
 
-// sweep the filesystem periodically to remove dead directory inodes.
-// run in a separate process to prevent FUSE deadlocks
+
+// work queue callback to run a requested sweep 
+static int eventfs_deferred_reap_cb( struct eventfs_wreq* wreq, void* cls ) {
+    
+    return eventfs_deferred_sweep( (struct eventfs_reaper*)cls );
+}
+
+
+// timer callback to run a sweep once it is due 
+static int eventfs_deferred_reap_timer_cb( struct eventfs_timer* timer, void* cls ) {
+    
+    return eventfs_deferred_sweep( (struct eventfs_reaper*)cls );
+}
+
+
+// ask for a sweep of the filesystem, to remove dead directory inodes.
+// the sweep runs in a separate process to prevent FUSE deadlocks.
+// requests made while one is pending are coalesced into it, and a sweep
+// asked for before the next one is due is put off until then.
 // return 0 on success
+// return -ENOMEM on OOM
 int eventfs_deferred_reap( struct eventfs_state* eventfs ) {
     
     int rc = 0;
+    struct eventfs_reaper* reaper = &eventfs->reaper;
     struct eventfs_wreq* work = NULL;
+    uint64_t now = eventfs_timer_now();
+    
+    pthread_mutex_lock( &reaper->lock );
+    
+    if( reaper->queued ) {
+        
+        // already coming
+        pthread_mutex_unlock( &reaper->lock );
+        return 0;
+    }
+    
+    if( now < reaper->next_sweep ) {
+        
+        // too soon; run it once it's due
+        reaper->queued = true;
+        eventfs_timer_schedule( &eventfs->timers, &reaper->timer, reaper->next_sweep );
+        
+        pthread_mutex_unlock( &reaper->lock );
+        return 0;
+    }
     
     work = EVENTFS_CALLOC( struct eventfs_wreq, 1 );
     if( work == NULL ) {
+        
+        pthread_mutex_unlock( &reaper->lock );
         return -ENOMEM;
     }
     
-    // deferred removal 
-   eventfs_wreq_init( work, eventfs_deferred_reap_cb, eventfs->mountpoint );
-   eventfs_wq_add( eventfs->deferred_wq, work );
-   return 0;
+    reaper->queued = true;
+    pthread_mutex_unlock( &reaper->lock );
+    
+    eventfs_wreq_init( work, eventfs_deferred_reap_cb, reaper );
+    eventfs_wq_add( eventfs->deferred_wq, work );
+    return 0;
+}
+
+
+// ask for a sweep only if one is due.
+// if process exits are being reported to us, sweeps are only a backstop, and are due far less often.
+// cheap enough to call on every mkdir: it costs a couple of atomic loads when no sweep is due.
+// return 0 on success
+// return -ENOMEM on OOM
+int eventfs_deferred_reap_if_due( struct eventfs_state* eventfs ) {
+    
+    uint64_t due = __atomic_load_n( &eventfs->reaper.next_sweep, __ATOMIC_SEQ_CST );
+    
+    if( eventfs->exitwatch.running ) {
+        
+        uint64_t backstop = __atomic_load_n( &eventfs->reaper.last_sweep, __ATOMIC_SEQ_CST ) + EVENTFS_REAP_BACKSTOP_INTERVAL;
+        if( backstop > due ) {
+            due = backstop;
+        }
+    }
+    
+    if( eventfs_timer_now() < due ) {
+        return 0;
+    }
+    
+    return eventfs_deferred_reap( eventfs );
+}
+
+
+// deferred reclaim context 
+struct eventfs_deferred_owner_reclaim_ctx {
+   
+   struct eventfs_state* eventfs;
+   uid_t uid;
+   struct eventfs_dir_inode* skip;              // only compared against
+};
+
+
+// work queue callback to reclaim a user's dead directories 
+static int eventfs_deferred_owner_reclaim_cb( struct eventfs_wreq* wreq, void* cls ) {
+    
+    struct eventfs_deferred_owner_reclaim_ctx* ctx = (struct eventfs_deferred_owner_reclaim_ctx*)cls;
+    int reclaimed = 0;
+    
+    reclaimed = eventfs_owner_reclaim( ctx->eventfs, NULL, ctx->uid, ctx->skip );
+    
+    eventfs_debug("DEFERRED: reclaimed %d directories of user %d\n", reclaimed, ctx->uid );
+    
+    eventfs_safe_free( ctx );
+    return 0;
+}
+
+
+// reclaim a user's dead directories from deferred_wq, for callers that hold locks the reclaim would need.
+// return 0 on success 
+// return -ENOMEM on OOM
+int eventfs_deferred_owner_reclaim( struct eventfs_state* eventfs, uid_t uid, struct eventfs_dir_inode* skip ) {
+    
+    struct eventfs_deferred_owner_reclaim_ctx* ctx = NULL;
+    struct eventfs_wreq* work = NULL;
+    
+    ctx = EVENTFS_CALLOC( struct eventfs_deferred_owner_reclaim_ctx, 1 );
+    if( ctx == NULL ) {
+        return -ENOMEM;
+    }
+    
+    work = EVENTFS_CALLOC( struct eventfs_wreq, 1 );
+    if( work == NULL ) {
+        
+        eventfs_safe_free( ctx );
+        return -ENOMEM;
+    }
+    
+    ctx->eventfs = eventfs;
+    ctx->uid = uid;
+    ctx->skip = skip;
+    
+    eventfs_wreq_init( work, eventfs_deferred_owner_reclaim_cb, ctx );
+    eventfs_wq_add( eventfs->deferred_wq, work );
+    return 0;
+}
+
+
+// record that a listing of the root found (and queued for removal) some dead directories.
+// this is how the scheduler learns how often sweeps are worth running.
+void eventfs_deferred_reap_found( struct eventfs_state* eventfs, uint64_t count ) {
+    
+    __atomic_add_fetch( &eventfs->reaper.found, count, __ATOMIC_SEQ_CST );
 }
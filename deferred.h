@@ -25,10 +25,50 @@
 #include "os.h"
 #include "wq.h"
 #include "util.h"
+#include "timer.h"
+
+// bounds on how many ticks apart sweeps are.
+// the gap doubles after each sweep that finds nothing dead, and halves after each one that does.
+#define EVENTFS_REAP_INTERVAL_MIN       1
+#define EVENTFS_REAP_INTERVAL_MAX       64
+
+// while process exits are reported to us as they happen, creation still sweeps at most this many ticks apart,
+// as a backstop for anything the reports missed
+#define EVENTFS_REAP_BACKSTOP_INTERVAL  256
+
+// a dead directory's files are unlinked this many at a time, so other deferred work gets a turn in between
+#define EVENTFS_GC_BATCH                1024
+
+// while its files are unlinked, a dead directory is moved out of the way to a name with this prefix, so its own name can be reused.
+// nobody else can make a directory with this prefix.
+#define EVENTFS_REAPED_PREFIX           ".reaped."
 
 struct eventfs_state;
+struct eventfs_dir_inode;
+
+// sweep scheduler.  Coalesces and rate-limits requests to sweep the filesystem.
+struct eventfs_reaper {
+   
+   pthread_mutex_t lock;
+   struct eventfs_state* eventfs;
+   
+   struct eventfs_timer timer;          // runs a sweep that was asked for before the next one was due
+   bool queued;                         // if true, then a sweep is queued on deferred_wq, or the timer is armed for one
+   pid_t child;                         // the last sweep's ls(1), which may still be running (and is not yet reaped)
+   
+   uint64_t interval;                   // ticks between sweeps
+   uint64_t next_sweep;                 // tick at which the next sweep is due (read without the lock)
+   uint64_t last_sweep;                 // tick at which the last sweep started (read without the lock)
+   uint64_t found;                      // dead directories found since the last sweep started (atomic)
+};
+
+int eventfs_reaper_init( struct eventfs_reaper* reaper, struct eventfs_state* eventfs );
+int eventfs_reaper_free( struct eventfs_reaper* reaper );
 
 int eventfs_deferred_remove( struct eventfs_state* eventfs, char const* child_path, struct fskit_entry* child );
 int eventfs_deferred_reap( struct eventfs_state* eventfs );
+int eventfs_deferred_reap_if_due( struct eventfs_state* eventfs );
+int eventfs_deferred_owner_reclaim( struct eventfs_state* eventfs, uid_t uid, struct eventfs_dir_inode* skip );
+void eventfs_deferred_reap_found( struct eventfs_state* eventfs, uint64_t count );
 
 #endif
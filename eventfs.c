@@ -27,9 +27,28 @@ struct eventfs_opts {
     char* config_path;
 };
 
-// try to prune dead directories every REAP_FREQUENCY mkdir's
-#define REAP_FREQUENCY 10
-int g_mkdir_count = 0;
+// who this thread acts as when eventfs calls into its own routes outside of FUSE (NULL when serving FUSE requests)
+static _Thread_local struct eventfs_caller* g_internal_caller = NULL;
+
+
+// act as the given caller on this thread, instead of the FUSE requester.
+// pass NULL to go back to serving FUSE requests.
+void eventfs_caller_set( struct eventfs_caller* caller ) {
+    g_internal_caller = caller;
+}
+
+// who is calling?
+pid_t eventfs_caller_pid() {
+    return (g_internal_caller != NULL ? g_internal_caller->pid : fskit_fuse_get_pid());
+}
+
+uid_t eventfs_caller_uid( struct eventfs_state* eventfs ) {
+    return (g_internal_caller != NULL ? g_internal_caller->uid : fskit_fuse_get_uid( eventfs->fuse_state ));
+}
+
+gid_t eventfs_caller_gid( struct eventfs_state* eventfs ) {
+    return (g_internal_caller != NULL ? g_internal_caller->gid : fskit_fuse_get_gid( eventfs->fuse_state ));
+}
 
 
 // locks on the quota sets 
@@ -45,28 +64,391 @@ int eventfs_quota_unlock( struct eventfs_state* eventfs ) {
     return pthread_rwlock_unlock( &eventfs->quota_lock );
 }
 
-// create a eventfs file 
-// return 0 on success
-// return -ENOMEM on OOM 
-// return negative on failure to initialize the inode
-int eventfs_create( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, mode_t mode, void** inode_data, void** handle_data ) {
+
+// index a directory under the user that created it, so the user can reclaim it once it's dead 
+// always succeeds
+// NOTE: the user must have a usage record by now
+static int eventfs_owner_add_dir( struct eventfs_state* eventfs, uid_t uid, struct eventfs_dir_inode* dir ) {
+   
+   eventfs_usage* usage = NULL;
+   
+   eventfs_quota_rlock( eventfs );
+   
+   usage = eventfs_usage_lookup( eventfs->user_usages, uid );
+   if( usage != NULL ) {
+      
+      pthread_mutex_lock( &eventfs->owner_lock );
+      
+      dir->owner_uid = uid;
+      dir->owner_prev = NULL;
+      dir->owner_next = usage->dirs;
+      
+      if( usage->dirs != NULL ) {
+         usage->dirs->owner_prev = dir;
+      }
+      
+      usage->dirs = dir;
+      dir->owner_indexed = true;
+      
+      pthread_mutex_unlock( &eventfs->owner_lock );
+   }
+   
+   eventfs_quota_unlock( eventfs );
+   return 0;
+}
+
+
+// remove a directory from its user's index, if it is in it
+// always succeeds
+int eventfs_owner_remove_dir( struct eventfs_state* eventfs, struct eventfs_dir_inode* dir ) {
    
-   eventfs_debug("eventfs_create(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+   eventfs_usage* usage = NULL;
+   
+   if( !dir->owner_indexed ) {
+      
+      // never indexed (only its creator's mkdir could have, and it's past that)
+      return 0;
+   }
+   
+   eventfs_quota_rlock( eventfs );
+   pthread_mutex_lock( &eventfs->owner_lock );
+   
+   if( dir->owner_indexed ) {
+      
+      usage = eventfs_usage_lookup( eventfs->user_usages, dir->owner_uid );
+      
+      if( dir->owner_prev != NULL ) {
+         dir->owner_prev->owner_next = dir->owner_next;
+      }
+      else if( usage != NULL ) {
+         usage->dirs = dir->owner_next;
+      }
+      
+      if( dir->owner_next != NULL ) {
+         dir->owner_next->owner_prev = dir->owner_prev;
+      }
+      
+      dir->owner_prev = NULL;
+      dir->owner_next = NULL;
+      dir->owner_indexed = false;
+   }
+   
+   pthread_mutex_unlock( &eventfs->owner_lock );
+   eventfs_quota_unlock( eventfs );
+   return 0;
+}
+
+
+// get how thoroughly to check a directory's creator:  its user.eventfs_verify xattr, if it names a discipline,
+// or the discipline it was created with.
+// NOTE: fent must be at least read-locked
+static int eventfs_dir_verify_discipline( struct fskit_core* core, char const* path, struct fskit_entry* fent, struct eventfs_dir_inode* inode ) {
    
    int rc = 0;
-   struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
+   char discipline[EVENTFS_VERIFY_BUF_LEN+1];
    
-   // NOTE: parent will be write-locked
-   struct fskit_entry* parent = fskit_route_metadata_get_parent( route_metadata );
-   struct eventfs_dir_inode* parent_inode = NULL;
-   struct eventfs_file_inode* inode = NULL;
+   memset( discipline, 0, EVENTFS_VERIFY_BUF_LEN+1 );
+   
+   rc = fskit_fgetxattr( core, path, fent, EVENTFS_XATTR_VERIFY, discipline, EVENTFS_VERIFY_BUF_LEN );
+   if( rc > 0 ) {
+      
+      if( strcmp( discipline, EVENTFS_VERIFY_NAME_FAST ) == 0 ) {
+         return EVENTFS_VERIFY_FAST;
+      }
+      
+      if( strcmp( discipline, EVENTFS_VERIFY_NAME_FULL ) == 0 ) {
+         return EVENTFS_VERIFY_DEFAULT;
+      }
+   }
+   
+   return inode->verify_discipline;
+}
+
+
+// monotonic time in milliseconds, for reclaim budgets
+static uint64_t eventfs_reclaim_now_ms() {
+   
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+// copy out the paths of a user's directories, so they can be checked one at a time without holding the owner lock.
+// takes at most EVENTFS_RECLAIM_SCAN_MAX of them, leaving out any that are already on their way out.
+// skip is a directory to leave out (e.g. one the caller has locked), and may be NULL; it is only compared against.
+// return the number found, and set *dir_paths to a NULL-terminated list of their paths (NULL if there are none)
+// return -ENOMEM on OOM
+static int eventfs_owner_list_dirs( struct eventfs_state* eventfs, uid_t uid, struct eventfs_dir_inode* skip, char*** dir_paths ) {
+   
+   int rc = 0;
+   int count = 0;
+   eventfs_usage* usage = NULL;
+   char** paths = NULL;
+   
+   *dir_paths = NULL;
+   
+   paths = EVENTFS_CALLOC( char*, EVENTFS_RECLAIM_SCAN_MAX + 1 );
+   if( paths == NULL ) {
+      return -ENOMEM;
+   }
+   
+   eventfs_quota_rlock( eventfs );
+   pthread_mutex_lock( &eventfs->owner_lock );
+   
+   usage = eventfs_usage_lookup( eventfs->user_usages, uid );
+   
+   for( struct eventfs_dir_inode* dir = (usage != NULL ? usage->dirs : NULL); dir != NULL && count < EVENTFS_RECLAIM_SCAN_MAX; dir = dir->owner_next ) {
+      
+      // only a hint; it is checked again with the directory locked
+      if( dir == skip || dir->deleted || dir->quota_credited || dir->path == NULL ) {
+         continue;
+      }
+      
+      paths[count] = strdup( dir->path );
+      if( paths[count] == NULL ) {
+         
+         rc = -ENOMEM;
+         break;
+      }
+      
+      count++;
+   }
+   
+   pthread_mutex_unlock( &eventfs->owner_lock );
+   eventfs_quota_unlock( eventfs );
+   
+   if( rc != 0 || count == 0 ) {
+      
+      for( int i = 0; i < count; i++ ) {
+         eventfs_safe_free( paths[i] );
+      }
+      
+      eventfs_safe_free( paths );
+      return rc;
+   }
+   
+   *dir_paths = paths;
+   return count;
+}
+
+
+// free a list of paths from eventfs_owner_list_dirs()
+static void eventfs_owner_list_free( char** dir_paths ) {
+   
+   if( dir_paths == NULL ) {
+      return;
+   }
+   
+   for( int i = 0; dir_paths[i] != NULL; i++ ) {
+      eventfs_safe_free( dir_paths[i] );
+   }
+   
+   eventfs_safe_free( dir_paths );
+}
+
+
+// reclaim one of a user's directories, if it is not sticky and its creator is dead.
+// it is flagged deleted and queued for removal like a sweep would, and is given back to its owner's quota right away.
+// return true if it was reclaimed
+// NOTE: child must be write-locked
+static bool eventfs_owner_reclaim_dir( struct eventfs_state* eventfs, char const* path, struct fskit_entry* child ) {
+   
+   int rc = 0;
+   struct eventfs_dir_inode* inode = (struct eventfs_dir_inode*)fskit_entry_get_user_data( child );
+   
+   if( fskit_entry_get_type( child ) != FSKIT_ENTRY_TYPE_DIR || inode == NULL || inode->deleted || inode->quota_credited ) {
+      return false;
+   }
+   
+   rc = fskit_fgetxattr( eventfs->core, path, child, "user.eventfs_sticky", NULL, 0 );
+   if( rc >= 0 ) {
+      
+      // sticky set 
+      return false;
+   }
+   
+   if( eventfs_dir_inode_is_valid( inode, eventfs_dir_verify_discipline( eventfs->core, path, child, inode ) ) != 0 ) {
+      
+      // creator is still alive (or it may have been recreated)
+      return false;
+   }
+   
+   uid_t owner_uid = fskit_entry_get_owner( child );
+   gid_t owner_gid = fskit_entry_get_group( child );
+   
+   inode->deleted = true;
+   
+   rc = eventfs_deferred_remove( eventfs, path, child );
+   if( rc != 0 ) {
+      
+      eventfs_error("eventfs_deferred_remove('%s') rc = %d\n", path, rc );
+      
+      // leave it for a sweep to find
+      inode->deleted = false;
+      return false;
+   }
+   
+   // give it back now, instead of once it's destroyed
+   inode->quota_credited = true;
+   
+   eventfs_quota_rlock( eventfs );
+   
+   if( eventfs_usage_lookup( eventfs->user_usages, owner_uid ) != NULL ) {
+      eventfs_usage_change_num_dirs( eventfs->user_usages, owner_uid, -1 );
+   }
+   
+   if( eventfs_usage_lookup( eventfs->group_usages, owner_gid ) != NULL ) {
+      eventfs_usage_change_num_dirs( eventfs->group_usages, owner_gid, -1 );
+   }
+   
+   eventfs_quota_unlock( eventfs );
+   
+   eventfs_debug("Reclaimed '%s' for user %d\n", path, owner_uid );
+   return true;
+}
+
+
+// reclaim up to EVENTFS_RECLAIM_MAX_DIRS of a user's dead directories, spending at most EVENTFS_RECLAIM_BUDGET_MS on it.
+// sticky directories are passed over, and do not count toward that.
+// each directory is checked with only itself locked, after the list of them has been copied out.
+// root is the root directory if the caller already has it write-locked (i.e. we're in mkdir), so each directory is
+// found in it directly; otherwise, root is NULL, and each directory is looked up by path.
+// skip is a directory to leave alone (e.g. one the caller has locked), and may be NULL.
+// return the number of directories reclaimed
+int eventfs_owner_reclaim( struct eventfs_state* eventfs, struct fskit_entry* root, uid_t uid, struct eventfs_dir_inode* skip ) {
    
+   int rc = 0;
+   int reclaimed = 0;
+   char** dir_paths = NULL;
    char name[FSKIT_FILESYSTEM_NAMEMAX+1];
-   memset( name, 0, FSKIT_FILESYSTEM_NAMEMAX + 1 );
+   struct fskit_entry* child = NULL;
+   uint64_t deadline_ms = eventfs_reclaim_now_ms() + EVENTFS_RECLAIM_BUDGET_MS;
+   
+   rc = eventfs_owner_list_dirs( eventfs, uid, skip, &dir_paths );
+   if( rc <= 0 ) {
+      return 0;
+   }
+   
+   for( int i = 0; dir_paths[i] != NULL && reclaimed < EVENTFS_RECLAIM_MAX_DIRS; i++ ) {
+      
+      if( eventfs_reclaim_now_ms() >= deadline_ms ) {
+         
+         // out of time
+         break;
+      }
+      
+      if( root != NULL ) {
+         
+         // root is already locked, so look it up directly instead of by path 
+         memset( name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+         fskit_basename( dir_paths[i], name );
+         
+         child = fskit_dir_find_by_name( root, name );
+         if( child == NULL ) {
+            continue;
+         }
+         
+         fskit_entry_wlock( child );
+      }
+      else {
+         
+         child = fskit_entry_resolve_path( eventfs->core, dir_paths[i], 0, 0, true, &rc );
+         if( child == NULL ) {
+            continue;
+         }
+      }
+      
+      if( eventfs_owner_reclaim_dir( eventfs, dir_paths[i], child ) ) {
+         reclaimed++;
+      }
+      
+      fskit_entry_unlock( child );
+   }
+   
+   eventfs_owner_list_free( dir_paths );
+   return reclaimed;
+}
+
+
+// start reclaiming a user's dead directories, so a file create that hit the user's file quota can be retried.
+// the directories are reclaimed on deferred_wq, since the caller holds a directory that mkdir could be waiting on
+// while it holds the root.  We don't wait for it with that directory locked; the caller gets EDQUOT this time,
+// and a retry finds the files given back once the reclaim has run.
+// NOTE: skip (the directory being written to) must be write-locked
+static void eventfs_file_quota_reclaim( struct eventfs_state* eventfs, struct eventfs_dir_inode* skip, uid_t uid ) {
+   
+   int rc = eventfs_deferred_owner_reclaim( eventfs, uid, skip );
+   if( rc != 0 ) {
+      
+      eventfs_error("eventfs_deferred_owner_reclaim(%d) rc = %d\n", uid, rc );
+   }
+}
+
+// make room in a full directory by unlinking its oldest files, if its overflow policy says to.
+// max_children is the number of children (including head, tail, and .push) the directory may have before the new file.
+// return 0 if there is now room 
+// return -EDQUOT if not 
+// NOTE: parent must be write-locked
+static int eventfs_file_overflow( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* parent, struct eventfs_dir_inode* parent_inode, uint64_t max_children ) {
+   
+   int rc = 0;
+   char policy[EVENTFS_OVERFLOW_BUF_LEN+1];
+   struct eventfs_file_deque* old_head = NULL;
+   
+   memset( policy, 0, EVENTFS_OVERFLOW_BUF_LEN+1 );
+   
+   rc = fskit_fgetxattr( eventfs->core, dir_path, parent, EVENTFS_XATTR_OVERFLOW, policy, EVENTFS_OVERFLOW_BUF_LEN );
+   if( rc <= 0 || strcmp( policy, EVENTFS_OVERFLOW_DROP_OLDEST ) != 0 ) {
+      
+      // producer must back off
+      return -EDQUOT;
+   }
+   
+   while( max_children <= (uint64_t)fskit_entry_get_num_children( parent ) + parent_inode->push_reserved ) {
+      
+      old_head = parent_inode->head;
+      if( old_head == NULL ) {
+         
+         // full of files that are not in the deque (i.e. staged)
+         return -EDQUOT;
+      }
+      
+      eventfs_debug("overflow: drop '%s/%s'\n", dir_path, old_head->name );
+      
+      rc = eventfs_dir_inode_pophead( eventfs->core, dir_path, parent_inode, parent );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_dir_inode_pophead('%s') rc = %d\n", dir_path, rc );
+         return -EDQUOT;
+      }
+      
+      if( parent_inode->head == old_head ) {
+         
+         // someone has it open, so it was detached but not destroyed.  Drop it from the deque anyway.
+         rc = eventfs_dir_inode_remove( eventfs->core, dir_path, parent_inode, parent, old_head->name );
+         if( rc != 0 ) {
+            
+            eventfs_error("eventfs_dir_inode_remove('%s') rc = %d\n", dir_path, rc );
+            return -EDQUOT;
+         }
+      }
+   }
    
-   pid_t calling_tid = fskit_fuse_get_pid();
-   uid_t calling_uid = fskit_fuse_get_uid( eventfs->fuse_state );
-   gid_t calling_gid = fskit_fuse_get_gid( eventfs->fuse_state );
+   return 0;
+}
+
+
+// charge one file against the quotas of the calling user and group, and against the parent directory's size quota.
+// if the directory is full and its overflow policy is drop-oldest, its oldest files get unlinked to make room.
+// return 0 on success 
+// return -EDQUOT if a quota would be exceeded 
+// return -ENOMEM on OOM 
+// NOTE: parent must be write-locked
+static int eventfs_file_quota_charge( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* parent, struct eventfs_dir_inode* parent_inode, uid_t calling_uid, gid_t calling_gid ) {
+   
+   int rc = 0;
    
    uint64_t file_quota_user = eventfs->config.default_file_quota;
    uint64_t dir_size_quota = eventfs->config.default_files_per_dir_quota;
@@ -75,6 +457,7 @@ int eventfs_create( struct fskit_core* core, struct fskit_route_metadata* route_
    uint64_t num_files_user = 0;
    uint64_t num_files_group = 0;
    uint64_t num_dir_children = 0;
+   uint64_t num_reserved_children = 2;
    uid_t parent_owner = 0;
    gid_t parent_group = 0;
    bool unknown_user = false;
@@ -83,10 +466,18 @@ int eventfs_create( struct fskit_core* core, struct fskit_route_metadata* route_
    eventfs_usage* new_user_usage = NULL;
    eventfs_usage* new_group_usage = NULL;
    
-   num_dir_children = fskit_entry_get_num_children( parent );
+   // messages that open .push handles have been charged for count as if they were already here
+   num_dir_children = (uint64_t)fskit_entry_get_num_children( parent ) + parent_inode->push_reserved;
    parent_owner = fskit_entry_get_owner( parent );
    parent_group = fskit_entry_get_group( parent );
    
+   // head, tail, .push, and cursors do not count against the directory
+   if( parent_inode->fent_push != NULL ) {
+      num_reserved_children++;
+   }
+   
+   num_reserved_children += parent_inode->num_cursors;
+   
    // look up quotas
    eventfs_quota_rlock( eventfs );
    
@@ -128,18 +519,13 @@ int eventfs_create( struct fskit_core* core, struct fskit_route_metadata* route_
    eventfs_quota_unlock( eventfs );
    
    // check quotas 
-   if( dir_size_quota + 2 <= num_dir_children ) {
-        
-       printf("User %d has per-directory quota of %d; using %d\n", calling_uid, (int)dir_size_quota, (int)(num_dir_children) );
-       
-       // directory has gotten too big
-       return -EDQUOT;
-   }
-   
    if( file_quota_user <= num_files_user ) {
     
        printf("User %d has file quota of %d; using %d\n", calling_uid, (int)file_quota_user, (int)(num_files_user) );
        
+       // get back whatever the user's dead directories hold, for next time
+       eventfs_file_quota_reclaim( eventfs, parent_inode, calling_uid );
+       
        // user has too many files
        // BUT!  Can we reap some directories?
        rc = eventfs_deferred_reap( eventfs );
@@ -166,6 +552,20 @@ int eventfs_create( struct fskit_core* core, struct fskit_route_metadata* route_
        return -EDQUOT;
    }
    
+   // check the directory last, so we don't evict anything if the user or group can't write anyway
+   if( dir_size_quota + num_reserved_children <= num_dir_children ) {
+        
+       printf("User %d has per-directory quota of %d; using %d\n", calling_uid, (int)dir_size_quota, (int)(num_dir_children) );
+       
+       // directory has gotten too big.
+       // make room, if we're allowed to
+       rc = eventfs_file_overflow( eventfs, dir_path, parent, parent_inode, dir_size_quota + num_reserved_children );
+       if( rc != 0 ) {
+          
+          return rc;
+       }
+   }
+   
    // set up new usages, if we need to 
    if( unknown_user ) {
        
@@ -185,72 +585,1072 @@ int eventfs_create( struct fskit_core* core, struct fskit_route_metadata* route_
        }
    }
    
-   // set up inode
-   inode = EVENTFS_CALLOC( struct eventfs_file_inode, 1 );
-   if( inode == NULL ) {
-       
-      eventfs_safe_free( new_user_usage );
-      eventfs_safe_free( new_group_usage );
-      return -ENOMEM;
+   // update usages 
+   if( !unknown_user ) {
+      
+      eventfs_usage_change_num_files( eventfs->user_usages, calling_uid, 1 );
+   }
+   else {
+      
+      eventfs_usage_init( new_user_usage, calling_uid, 1, 0, 0 );
+      eventfs_usage_put( &eventfs->user_usages, new_user_usage );
    }
    
-   rc = eventfs_file_inode_init( inode );
-   if( rc != 0 ) {
-       
-      // phantom process?
-      eventfs_safe_free( inode );
-      eventfs_safe_free( new_user_usage );
-      eventfs_safe_free( new_group_usage );
-      return rc;
+   if( !unknown_group ) {
+      
+      eventfs_usage_change_num_files( eventfs->group_usages, calling_gid, 1 );
+   }
+   else {
+      
+      eventfs_usage_init( new_group_usage, calling_gid, 1, 0, 0 );
+      eventfs_usage_put( &eventfs->group_usages, new_group_usage );
    }
    
-   // attach to parent (will already be write-locked)
-   parent_inode = (struct eventfs_dir_inode*)fskit_entry_get_user_data( parent );
+   return 0;
+}
+
+
+// give back a file charged with eventfs_file_quota_charge(), if we failed to create it after all
+static void eventfs_file_quota_refund( struct eventfs_state* eventfs, uid_t calling_uid, gid_t calling_gid ) {
+   
+   eventfs_quota_rlock( eventfs );
+   
+   if( eventfs_usage_lookup( eventfs->user_usages, calling_uid ) != NULL ) {
+      
+      eventfs_usage_change_num_files( eventfs->user_usages, calling_uid, -1 );
+   }
+   
+   if( eventfs_usage_lookup( eventfs->group_usages, calling_gid ) != NULL ) {
+      
+      eventfs_usage_change_num_files( eventfs->group_usages, calling_gid, -1 );
+   }
+   
+   eventfs_quota_unlock( eventfs );
+}
+
+
+// create a directory's .push file, through which producers submit auto-sequenced messages.
+// the creator gets a .push handle, just as if it had opened the existing file, and is charged for the message it will publish.
+// return 0 on success, and set *inode_data and *handle_data
+// return -EEXIST if the directory already has a .push file 
+// return -EDQUOT if the message would exceed a quota
+// return -ENOMEM on OOM 
+// NOTE: parent must be write-locked
+static int eventfs_create_push( struct eventfs_state* eventfs, char const* path, struct fskit_entry* fent, struct fskit_entry* parent, struct eventfs_dir_inode* parent_inode, void** inode_data, void** handle_data ) {
+   
+   int rc = 0;
+   struct eventfs_file_inode* inode = NULL;
+   struct eventfs_file_handle* handle = NULL;
+   char* dir_path = NULL;
+   
+   if( parent_inode->fent_push != NULL ) {
+      return -EEXIST;
+   }
+   
+   dir_path = fskit_dirname( path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   inode = EVENTFS_CALLOC( struct eventfs_file_inode, 1 );
+   if( inode == NULL ) {
+      
+      eventfs_safe_free( dir_path );
+      return -ENOMEM;
+   }
+   
+   handle = eventfs_file_handle_new( EVENTFS_HANDLE_PUSH, eventfs_caller_uid( eventfs ), eventfs_caller_gid( eventfs ) );
+   if( handle == NULL ) {
+      
+      eventfs_safe_free( inode );
+      eventfs_safe_free( dir_path );
+      return -ENOMEM;
+   }
+   
+   // charge now, since close can't report that the message didn't fit
+   rc = eventfs_file_quota_charge( eventfs, dir_path, parent, parent_inode, handle->owner, handle->group );
+   eventfs_safe_free( dir_path );
+   
+   if( rc != 0 ) {
+      
+      eventfs_file_handle_free( handle );
+      eventfs_safe_free( handle );
+      eventfs_safe_free( inode );
+      return rc;
+   }
+   
+   eventfs_file_inode_init( inode );
+   inode->flags |= EVENTFS_FILE_PUSH;
+   
+   handle->dir_generation = parent_inode->generation;
+   handle->reserved = true;
+   parent_inode->push_reserved++;
+   parent_inode->fent_push = fent;
+   
+   *inode_data = (void*)inode;
+   *handle_data = (void*)handle;
+   return rc;
+}
+
+
+// create a directory's .lease file, and put the directory in lease mode.
+// only the directory's owner may do this, since it takes the directory out of its creator's hands.
+// return 0 on success, and set *inode_data 
+// return -EPERM if the caller does not own the directory
+// return -ENOMEM on OOM 
+// NOTE: parent must be write-locked
+static int eventfs_create_lease( struct eventfs_state* eventfs, char const* path, struct fskit_entry* parent, struct eventfs_dir_inode* parent_inode, void** inode_data ) {
+   
+   int rc = 0;
+   struct eventfs_file_inode* inode = NULL;
+   
+   if( eventfs_caller_uid( eventfs ) != fskit_entry_get_owner( parent ) ) {
+      return -EPERM;
+   }
+   
+   char* dir_path = fskit_dirname( path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   inode = EVENTFS_CALLOC( struct eventfs_file_inode, 1 );
+   if( inode == NULL ) {
+      
+      eventfs_safe_free( dir_path );
+      return -ENOMEM;
+   }
+   
+   rc = eventfs_lease_start( eventfs, dir_path, parent, parent_inode );
+   eventfs_safe_free( dir_path );
+   
+   if( rc != 0 ) {
+      
+      eventfs_safe_free( inode );
+      return rc;
+   }
+   
+   eventfs_file_inode_init( inode );
+   inode->flags |= EVENTFS_FILE_LEASE;
+   
+   *inode_data = (void*)inode;
+   return 0;
+}
+
+
+// renew the lease on the directory a .lease file is in.
+// only the directory's owner may renew it; anyone else could keep it alive forever.
+// return 0 on success, or if the directory is gone
+// return -EPERM if the caller does not own the directory
+// return -ENOMEM on OOM
+static int eventfs_lease_touch( struct eventfs_state* eventfs, char const* lease_path ) {
+   
+   int rc = 0;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   
+   char* dir_path = fskit_dirname( lease_path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   dent = fskit_entry_resolve_path( eventfs->core, dir_path, 0, 0, false, &rc );
+   eventfs_safe_free( dir_path );
+   
+   if( dent == NULL ) {
+      return 0;
+   }
+   
+   if( eventfs_caller_uid( eventfs ) != fskit_entry_get_owner( dent ) ) {
+      
+      fskit_entry_unlock( dent );
+      return -EPERM;
+   }
+   
+   dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   if( dir != NULL && !dir->deleted ) {
+      
+      eventfs_lease_renew( dir );
+   }
+   
+   fskit_entry_unlock( dent );
+   return 0;
+}
+
+
+// bind a .push handle to the directory its file is in, so publications through it can be matched to that directory.
+// a generation is never reused, unlike the directory's name or the address of its inode.
+// a handle that will be written to is charged for the message it will publish now, since close can't report that it didn't fit.
+// return 0 on success, and set the handle's dir_generation (and reserved, if charged)
+// return -ENOENT if the directory is gone 
+// return -EDQUOT if the message would exceed a quota 
+// return -ENOMEM on OOM
+static int eventfs_push_bind( struct eventfs_state* eventfs, char const* push_path, struct eventfs_file_handle* handle, bool charge ) {
+   
+   int rc = 0;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   
+   char* dir_path = fskit_dirname( push_path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   dent = fskit_entry_resolve_path( eventfs->core, dir_path, 0, 0, charge, &rc );
+   if( dent == NULL ) {
+      
+      eventfs_safe_free( dir_path );
+      return -ENOENT;
+   }
+   
+   dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   if( dir == NULL || dir->deleted ) {
+      
+      // reaped
+      fskit_entry_unlock( dent );
+      eventfs_safe_free( dir_path );
+      return -ENOENT;
+   }
+   
+   if( charge ) {
+      
+      rc = eventfs_file_quota_charge( eventfs, dir_path, dent, dir, handle->owner, handle->group );
+      if( rc == 0 ) {
+         
+         handle->reserved = true;
+         dir->push_reserved++;
+      }
+   }
+   
+   handle->dir_generation = dir->generation;
+   
+   fskit_entry_unlock( dent );
+   eventfs_safe_free( dir_path );
+   return rc;
+}
+
+
+// give back what a .push handle was charged for a message it never published 
+// return 0 on success 
+// return -ENOMEM on OOM (the user and group still get the file back)
+static int eventfs_push_unbind( struct eventfs_state* eventfs, char const* push_path, struct eventfs_file_handle* handle ) {
+   
+   int rc = 0;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   char* dir_path = NULL;
+   
+   if( !handle->reserved ) {
+      return 0;
+   }
+   
+   eventfs_file_quota_refund( eventfs, handle->owner, handle->group );
+   handle->reserved = false;
+   
+   dir_path = fskit_dirname( push_path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   dent = fskit_entry_resolve_path( eventfs->core, dir_path, 0, 0, true, &rc );
+   eventfs_safe_free( dir_path );
+   
+   if( dent != NULL ) {
+      
+      dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+      if( dir != NULL && dir->generation == handle->dir_generation ) {
+         
+         dir->push_reserved--;
+      }
+      
+      fskit_entry_unlock( dent );
+   }
+   
+   return 0;
+}
+
+
+// create a consumer cursor file, positioned at the directory's head.
+// the creator gets a cursor handle, just as if it had opened the existing file for writing.
+// return 0 on success, and set *inode_data and *handle_data 
+// return -EINVAL if the cursor has no name 
+// return -ENOMEM on OOM 
+// NOTE: parent must be write-locked
+static int eventfs_create_cursor( struct eventfs_state* eventfs, struct fskit_entry* fent, struct eventfs_dir_inode* parent_inode, char const* name, void** inode_data, void** handle_data ) {
+   
+   int rc = 0;
+   struct eventfs_file_inode* inode = NULL;
+   struct eventfs_file_handle* handle = NULL;
+   
+   if( strlen( name ) <= strlen( EVENTFS_CURSOR_PREFIX ) ) {
+      return -EINVAL;
+   }
+   
+   inode = EVENTFS_CALLOC( struct eventfs_file_inode, 1 );
+   if( inode == NULL ) {
+      return -ENOMEM;
+   }
+   
+   eventfs_file_inode_init( inode );
+   
+   // NOTE: fent is not attached yet; we size it ourselves below
+   inode->cursor = eventfs_cursor_new( NULL );
+   if( inode->cursor == NULL ) {
+      
+      eventfs_safe_free( inode );
+      return -ENOMEM;
+   }
+   
+   handle = eventfs_file_handle_new( EVENTFS_HANDLE_CURSOR, eventfs_caller_uid( eventfs ), eventfs_caller_gid( eventfs ) );
+   if( handle == NULL ) {
+      
+      eventfs_file_inode_free( inode );
+      eventfs_safe_free( inode );
+      return -ENOMEM;
+   }
+   
+   rc = eventfs_dir_inode_cursor_add( parent_inode, inode->cursor );
+   if( rc != 0 ) {
+      
+      eventfs_file_handle_free( handle );
+      eventfs_safe_free( handle );
+      eventfs_file_inode_free( inode );
+      eventfs_safe_free( inode );
+      return rc;
+   }
+   
+   inode->flags |= EVENTFS_FILE_CURSOR;
+   inode->cursor->fent = fent;
+   
+   if( inode->cursor->target != NULL ) {
+      fskit_entry_set_size( fent, strlen( inode->cursor->target ) );
+   }
+   
+   *inode_data = (void*)inode;
+   *handle_data = (void*)handle;
+   return rc;
+}
+
+
+// create a eventfs file 
+// creating the reserved name EVENTFS_PUSH_NAME sets up the directory's .push file instead of a message.
+// creating a name that starts with EVENTFS_CURSOR_PREFIX sets up a consumer cursor.
+// creating EVENTFS_LEASE_NAME puts the directory in lease mode.
+// if the directory has "user.eventfs_staged" set, the file does not join the deque until its creator closes or fsyncs it.
+// return 0 on success
+// return -ENOMEM on OOM 
+// return negative on failure to initialize the inode
+int eventfs_create( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, mode_t mode, void** inode_data, void** handle_data ) {
+   
+   eventfs_debug("eventfs_create(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
+   
+   int rc = 0;
+   struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
+   
+   // NOTE: parent will be write-locked
+   struct fskit_entry* parent = fskit_route_metadata_get_parent( route_metadata );
+   struct eventfs_dir_inode* parent_inode = NULL;
+   struct eventfs_file_inode* inode = NULL;
+   struct eventfs_file_handle* handle = NULL;
+   char* name = fskit_route_metadata_get_name( route_metadata );
+   char* dir_path = NULL;
+   bool staged = false;
+   
+   pid_t calling_tid = eventfs_caller_pid();
+   uid_t calling_uid = eventfs_caller_uid( eventfs );
+   gid_t calling_gid = eventfs_caller_gid( eventfs );
+   
+   // attach to parent (will already be write-locked)
+   parent_inode = (struct eventfs_dir_inode*)fskit_entry_get_user_data( parent );
    if( parent_inode == NULL ) {
        
        eventfs_error("BUG: parent %p has no inode data!\n", parent );
-       eventfs_file_inode_free( inode );
-       eventfs_safe_free( inode );
-       eventfs_safe_free( new_user_usage );
-       eventfs_safe_free( new_group_usage );
        return -EIO;
    }
    
-   rc = eventfs_dir_inode_append( core, parent_inode, parent, fskit_route_metadata_get_name( route_metadata ) );
-   if( rc != 0 ) {
-       
-       // failed 
-       eventfs_file_inode_free( inode );
-       eventfs_safe_free( inode );
-       eventfs_safe_free( new_user_usage );
-       eventfs_safe_free( new_group_usage );
-       return rc;
+   if( strcmp( name, EVENTFS_PUSH_NAME ) == 0 ) {
+       
+       // not a message
+       return eventfs_create_push( eventfs, fskit_route_metadata_get_path( route_metadata ), fent, parent, parent_inode, inode_data, handle_data );
+   }
+   
+   if( strncmp( name, EVENTFS_CURSOR_PREFIX, strlen(EVENTFS_CURSOR_PREFIX) ) == 0 ) {
+       
+       // not a message either
+       return eventfs_create_cursor( eventfs, fent, parent_inode, name, inode_data, handle_data );
+   }
+   
+   if( strcmp( name, EVENTFS_LEASE_NAME ) == 0 ) {
+       
+       // nor this
+       return eventfs_create_lease( eventfs, fskit_route_metadata_get_path( route_metadata ), parent, parent_inode, inode_data );
+   }
+   
+   // publish on close?
+   dir_path = fskit_dirname( fskit_route_metadata_get_path( route_metadata ), NULL );
+   if( dir_path == NULL ) {
+       return -ENOMEM;
+   }
+   
+   rc = fskit_fgetxattr( core, dir_path, parent, "user.eventfs_staged", NULL, 0 );
+   if( rc >= 0 ) {
+       
+       staged = true;
+   }
+   
+   rc = 0;
+   
+   // check and charge quotas
+   rc = eventfs_file_quota_charge( eventfs, dir_path, parent, parent_inode, calling_uid, calling_gid );
+   if( rc != 0 ) {
+       
+       eventfs_safe_free( dir_path );
+       return rc;
+   }
+   
+   // set up inode
+   inode = EVENTFS_CALLOC( struct eventfs_file_inode, 1 );
+   if( inode == NULL ) {
+       
+      eventfs_safe_free( dir_path );
+      eventfs_file_quota_refund( eventfs, calling_uid, calling_gid );
+      return -ENOMEM;
+   }
+   
+   rc = eventfs_file_inode_init( inode );
+   if( rc != 0 ) {
+       
+      // phantom process?
+      eventfs_safe_free( inode );
+      eventfs_safe_free( dir_path );
+      eventfs_file_quota_refund( eventfs, calling_uid, calling_gid );
+      return rc;
+   }
+   
+   if( staged ) {
+       
+       // the creator's handle will publish it
+       handle = eventfs_file_handle_new( EVENTFS_HANDLE_STAGED, calling_uid, calling_gid );
+       if( handle == NULL ) {
+           
+           eventfs_safe_free( inode );
+           eventfs_safe_free( dir_path );
+           eventfs_file_quota_refund( eventfs, calling_uid, calling_gid );
+           return -ENOMEM;
+       }
+       
+       inode->flags |= EVENTFS_FILE_STAGED;
+       *handle_data = (void*)handle;
+   }
+   else {
+       
+       rc = eventfs_dir_inode_append( core, parent_inode, parent, name );
+       if( rc != 0 ) {
+           
+           // failed 
+           eventfs_file_inode_free( inode );
+           eventfs_safe_free( inode );
+           eventfs_safe_free( dir_path );
+           eventfs_file_quota_refund( eventfs, calling_uid, calling_gid );
+           return rc;
+       }
+       
+       rc = eventfs_ttl_arm( eventfs, dir_path, parent, parent_inode, NULL, NULL );
+       if( rc != 0 ) {
+           
+           eventfs_error("eventfs_ttl_arm('%s') rc = %d\n", dir_path, rc );
+           rc = 0;
+       }
+       
+       // the body gets journaled on close
+       rc = eventfs_journal_log_append( eventfs, dir_path, parent, parent_inode, fent, name, NULL );
+       if( rc != 0 ) {
+           
+           eventfs_error("eventfs_journal_log_append('%s') rc = %d\n", dir_path, rc );
+           rc = 0;
+       }
+   }
+   
+   eventfs_safe_free( dir_path );
+   *inode_data = (void*)inode;
+   
+   return rc;
+}
+
+
+// publish a staged file: append it to its directory's deque, if it is still attached there and has not been published yet.
+// return 0 on success, or if the file was already published 
+// return -ENOENT if the directory or file is gone 
+// return -ENOMEM on OOM 
+static int eventfs_staged_publish( struct eventfs_state* eventfs, char const* path, struct fskit_entry* fent, uid_t owner, gid_t group ) {
+   
+   int rc = 0;
+   struct fskit_core* core = eventfs->core;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   struct eventfs_file_inode* inode = NULL;
+   char* dir_path = NULL;
+   char name[FSKIT_FILESYSTEM_NAMEMAX+1];
+   
+   memset( name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+   fskit_basename( path, name );
+   
+   dir_path = fskit_dirname( path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   dent = fskit_entry_resolve_path( core, dir_path, owner, group, true, &rc );
+   if( dent == NULL ) {
+      
+      eventfs_safe_free( dir_path );
+      return rc;
+   }
+   
+   dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   if( dir == NULL || dir->deleted ) {
+      
+      // reaped 
+      fskit_entry_unlock( dent );
+      eventfs_safe_free( dir_path );
+      return -ENOENT;
+   }
+   
+   if( fskit_dir_find_by_name( dent, name ) != fent ) {
+      
+      // unlinked before it was published 
+      fskit_entry_unlock( dent );
+      eventfs_safe_free( dir_path );
+      return -ENOENT;
+   }
+   
+   fskit_entry_rlock( fent );
+   inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( fent );
+   fskit_entry_unlock( fent );
+   
+   if( inode == NULL || (inode->flags & EVENTFS_FILE_STAGED) == 0 ) {
+      
+      // already published
+      fskit_entry_unlock( dent );
+      eventfs_safe_free( dir_path );
+      return 0;
    }
    
-   *inode_data = (void*)inode;
+   rc = eventfs_dir_inode_append( core, dir, dent, name );
+   if( rc == 0 ) {
+      
+      // NOTE: the flag is only ever changed with the parent write-locked
+      inode->flags &= ~EVENTFS_FILE_STAGED;
+      
+      // the producer may have given this message its own TTL
+      rc = eventfs_ttl_arm( eventfs, dir_path, dent, dir, path, fent );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_ttl_arm('%s') rc = %d\n", path, rc );
+         rc = 0;
+      }
+      
+      rc = eventfs_journal_log_append( eventfs, dir_path, dent, dir, fent, name, inode );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_journal_log_append('%s') rc = %d\n", path, rc );
+         rc = 0;
+      }
+   }
    
-   // update usages 
-   if( !unknown_user ) {
+   fskit_entry_unlock( dent );
+   eventfs_safe_free( dir_path );
+   return rc;
+}
+
+
+// publish one message staged through a .push handle: attach its entry to the directory under the next sequence number,
+// and append it to the deque.  It takes the place it was charged for when the handle was opened.
+// return 0 on success 
+// return -EDQUOT if a quota would be exceeded (only if the handle was not charged when it was opened)
+// return -ENOMEM on OOM 
+// NOTE: dent must be write-locked, and not deleted
+static int eventfs_push_publish_locked( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* dent, struct eventfs_dir_inode* dir, struct eventfs_push_req* req ) {
+   
+   int rc = 0;
+   struct fskit_core* core = eventfs->core;
+   struct eventfs_file_handle* handle = req->handle;
+   struct fskit_entry* fent = req->fent;
+   char name[EVENTFS_SEQ_NAME_LEN+1];
+   
+   memset( name, 0, EVENTFS_SEQ_NAME_LEN+1 );
+   
+   if( !handle->reserved ) {
       
-      eventfs_usage_change_num_files( eventfs->user_usages, calling_uid, 1 );
+      // not charged when it was opened
+      rc = eventfs_file_quota_charge( eventfs, dir_path, dent, dir, handle->owner, handle->group );
+      if( rc != 0 ) {
+         return rc;
+      }
    }
    else {
       
-      eventfs_usage_init( new_user_usage, calling_uid, 1, 0, 0 );
-      eventfs_usage_put( &eventfs->user_usages, new_user_usage );
+      // the message takes the place it was charged for
+      dir->push_reserved--;
+      handle->reserved = false;
    }
    
-   if( !unknown_group ) {
+   eventfs_dir_inode_next_seq_name( dir, dent, name );
+   
+   rc = eventfs_dir_inode_append_seq( core, dir, dent, name );
+   if( rc != 0 ) {
       
-      eventfs_usage_change_num_files( eventfs->group_usages, calling_gid, 1 );
+      eventfs_file_quota_refund( eventfs, handle->owner, handle->group );
+      return rc;
+   }
+   
+   // hand over the body 
+   fskit_entry_set_user_data( fent, handle->staged );
+   fskit_entry_set_size( fent, handle->staged->size );
+   handle->staged = NULL;
+   
+   fskit_entry_attach_lowlevel( dent, fent, name );
+   req->fent = NULL;
+   
+   rc = eventfs_ttl_arm( eventfs, dir_path, dent, dir, NULL, NULL );
+   if( rc != 0 ) {
+      
+      eventfs_error("eventfs_ttl_arm('%s') rc = %d\n", dir_path, rc );
+   }
+   
+   rc = eventfs_journal_log_append( eventfs, dir_path, dent, dir, fent, name, (struct eventfs_file_inode*)fskit_entry_get_user_data( fent ) );
+   if( rc != 0 ) {
+      
+      eventfs_error("eventfs_journal_log_append('%s/%s') rc = %d\n", dir_path, name, rc );
+   }
+   
+   eventfs_debug("Published '%s/%s'\n", dir_path, name );
+   return 0;
+}
+
+
+// publish a batch of .push messages bound for the same directory, under a single acquisition of its lock 
+// each request's rc is set to the outcome of publishing it (-ENOENT if the directory at dir_path is not the one its .push was opened in).
+static void eventfs_push_publish_batch( struct eventfs_state* eventfs, char const* dir_path, struct eventfs_push_req* batch ) {
+   
+   int rc = 0;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   
+   // NOTE: each producer's access was checked when it opened .push, and each message is charged to its own producer
+   dent = fskit_entry_resolve_path( eventfs->core, dir_path, 0, 0, true, &rc );
+   if( dent != NULL ) {
+      
+      dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+      if( dir == NULL || dir->deleted ) {
+         
+         // reaped 
+         rc = -ENOENT;
+      }
+   }
+   
+   for( struct eventfs_push_req* req = batch; req != NULL; req = req->next ) {
+      
+      if( dent != NULL && rc != -ENOENT && req->handle->dir_generation != dir->generation ) {
+         
+         // the directory this .push was opened in was reaped, and another one took its name
+         req->rc = -ENOENT;
+      }
+      else if( dent != NULL && rc != -ENOENT ) {
+         req->rc = eventfs_push_publish_locked( eventfs, dir_path, dent, dir, req );
+      }
+      else {
+         req->rc = rc;
+      }
+   }
+   
+   if( dent != NULL ) {
+      fskit_entry_unlock( dent );
+   }
+}
+
+
+// publish a message staged through a .push handle: attach it to its directory under the next sequence number,
+// and append it to the deque.
+// producers that publish to the same directory at the same time are combined: whichever one gets there first
+// publishes everyone's pending messages under one acquisition of the directory lock, while the others wait on the directory's .push queue.
+// return 0 on success 
+// return -ENOENT if the directory is gone 
+// return -EDQUOT if a quota would be exceeded 
+// return -ENOMEM on OOM 
+static int eventfs_push_publish( struct eventfs_state* eventfs, char const* push_path, struct eventfs_file_handle* handle ) {
+   
+   int rc = 0;
+   struct eventfs_push_req req;
+   struct eventfs_push_req* batch = NULL;
+   struct eventfs_push_req* next = NULL;
+   struct eventfs_push_queue* queue = NULL;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   char* dir_path = NULL;
+   uint64_t file_id = 0;
+   
+   memset( &req, 0, sizeof(struct eventfs_push_req) );
+   
+   dir_path = fskit_dirname( push_path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   // set up the entry before anyone locks the directory 
+   req.handle = handle;
+   req.fent = fskit_entry_new();
+   if( req.fent == NULL ) {
+      
+      eventfs_safe_free( dir_path );
+      return -ENOMEM;
+   }
+   
+   file_id = eventfs_inode_number_alloc();
+   
+   rc = fskit_entry_init_file( req.fent, file_id, handle->owner, handle->group, 0644 );
+   if( rc != 0 ) {
+      
+      eventfs_inode_number_release( file_id );
+      eventfs_safe_free( req.fent );
+      eventfs_safe_free( dir_path );
+      return rc;
+   }
+   
+   // find the queue of the directory this .push was opened in 
+   dent = fskit_entry_resolve_path( eventfs->core, dir_path, 0, 0, false, &rc );
+   if( dent != NULL ) {
+      
+      dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+      if( dir != NULL && !dir->deleted && dir->generation == handle->dir_generation ) {
+         queue = eventfs_push_queue_ref( dir->push_queue );
+      }
+      
+      fskit_entry_unlock( dent );
+   }
+   
+   if( queue == NULL ) {
+      
+      // reaped 
+      eventfs_inode_number_release( file_id );
+      fskit_entry_destroy( eventfs->core, req.fent, false );
+      eventfs_safe_free( req.fent );
+      eventfs_safe_free( dir_path );
+      return -ENOENT;
+   }
+   
+   pthread_mutex_lock( &queue->lock );
+   
+   // get in line 
+   *queue->pending_tail = &req;
+   queue->pending_tail = &req.next;
+   
+   // wait for a combiner to publish it, or become the combiner
+   while( !req.done && queue->combining ) {
+      pthread_cond_wait( &queue->cond, &queue->lock );
+   }
+   
+   if( !req.done ) {
+      
+      queue->combining = true;
+      
+      while( !req.done ) {
+         
+         // take everything that's pending, including our own
+         batch = queue->pending;
+         queue->pending = NULL;
+         queue->pending_tail = &queue->pending;
+         
+         pthread_mutex_unlock( &queue->lock );
+         
+         eventfs_push_publish_batch( eventfs, dir_path, batch );
+         
+         pthread_mutex_lock( &queue->lock );
+         
+         for( struct eventfs_push_req* itr = batch; itr != NULL; itr = next ) {
+            
+            // NOTE: itr may be gone as soon as it is marked done
+            next = itr->next;
+            itr->done = true;
+         }
+         
+         // let the producers in this batch go
+         pthread_cond_broadcast( &queue->cond );
+      }
+      
+      // let a waiter take over whatever arrived in the meantime
+      queue->combining = false;
+      pthread_cond_broadcast( &queue->cond );
+   }
+   
+   pthread_mutex_unlock( &queue->lock );
+   
+   eventfs_push_queue_unref( queue );
+   
+   if( req.fent != NULL ) {
+      
+      // not published
+      eventfs_inode_number_release( file_id );
+      fskit_entry_destroy( eventfs->core, req.fent, false );
+      eventfs_safe_free( req.fent );
+   }
+   
+   eventfs_safe_free( dir_path );
+   return req.rc;
+}
+
+
+// move a cursor past the file named in what was written to its handle (or past its current file, if nothing was), 
+// and reclaim the files that every cursor has now passed.
+// return 0 on success 
+// return -ENOENT if the directory is gone, or the cursor already passed the named file
+// return -ENOMEM on OOM
+static int eventfs_cursor_commit( struct eventfs_state* eventfs, char const* path, struct fskit_entry* fent, struct eventfs_file_handle* handle ) {
+   
+   int rc = 0;
+   struct fskit_core* core = eventfs->core;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   struct eventfs_file_inode* inode = NULL;
+   char* dir_path = NULL;
+   char ack[FSKIT_FILESYSTEM_NAMEMAX+1];
+   
+   // what are we acknowledging?
+   memset( ack, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+   eventfs_file_inode_read( handle->staged, ack, FSKIT_FILESYSTEM_NAMEMAX, 0 );
+   
+   ack[ strcspn( ack, "\n" ) ] = '\0';
+   
+   dir_path = fskit_dirname( path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   dent = fskit_entry_resolve_path( core, dir_path, handle->owner, handle->group, true, &rc );
+   if( dent == NULL ) {
+      
+      eventfs_safe_free( dir_path );
+      return rc;
+   }
+   
+   dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   if( dir == NULL || dir->deleted ) {
+      
+      // reaped 
+      fskit_entry_unlock( dent );
+      eventfs_safe_free( dir_path );
+      return -ENOENT;
+   }
+   
+   fskit_entry_rlock( fent );
+   inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( fent );
+   fskit_entry_unlock( fent );
+   
+   if( inode == NULL || inode->cursor == NULL ) {
+      
+      // unlinked 
+      fskit_entry_unlock( dent );
+      eventfs_safe_free( dir_path );
+      return -ENOENT;
+   }
+   
+   rc = eventfs_dir_inode_cursor_advance( dir, inode->cursor, ack );
+   if( rc == 0 ) {
+      
+      rc = eventfs_dir_inode_cursor_reclaim( core, dir_path, dir, dent );
+   }
+   
+   fskit_entry_unlock( dent );
+   eventfs_safe_free( dir_path );
+   return rc;
+}
+
+
+// open a file.
+// opening a directory's .push file gets a fresh handle to stage a message in.
+// opening a cursor file for writing gets a handle that moves the cursor on close.
+// opening a .lease file renews the directory's lease.
+// return 0 on success
+// return -EPERM if the caller opened a .lease file in a directory it does not own
+// return -ENOMEM on OOM
+int eventfs_open( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, int flags, void** handle_data ) {
+   
+   eventfs_debug("eventfs_open(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
+   
+   struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
+   struct eventfs_file_inode* inode = NULL;
+   struct eventfs_file_handle* handle = NULL;
+   int rc = 0;
+   
+   fskit_entry_rlock( fent );
+   
+   if( fskit_entry_get_type( fent ) != FSKIT_ENTRY_TYPE_FILE ) {
+      
+      fskit_entry_unlock( fent );
+      return 0;
+   }
+   
+   inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( fent );
+   
+   fskit_entry_unlock( fent );
+   
+   if( inode != NULL && (inode->flags & EVENTFS_FILE_LEASE) != 0 ) {
+      
+      // e.g. touch(1).  No handle needed.
+      return eventfs_lease_touch( eventfs, fskit_route_metadata_get_path( route_metadata ) );
+   }
+   
+   if( inode != NULL && (inode->flags & EVENTFS_FILE_PUSH) != 0 ) {
+      
+      handle = eventfs_file_handle_new( EVENTFS_HANDLE_PUSH, eventfs_caller_uid( eventfs ), eventfs_caller_gid( eventfs ) );
+      if( handle == NULL ) {
+         return -ENOMEM;
+      }
+      
+      rc = eventfs_push_bind( eventfs, fskit_route_metadata_get_path( route_metadata ), handle, (flags & O_ACCMODE) != O_RDONLY );
+      if( rc != 0 ) {
+         
+         eventfs_file_handle_free( handle );
+         eventfs_safe_free( handle );
+         return rc;
+      }
+   }
+   else if( inode != NULL && (inode->flags & EVENTFS_FILE_CURSOR) != 0 && (flags & O_ACCMODE) != O_RDONLY ) {
+      
+      handle = eventfs_file_handle_new( EVENTFS_HANDLE_CURSOR, eventfs_caller_uid( eventfs ), eventfs_caller_gid( eventfs ) );
    }
    else {
       
-      eventfs_usage_init( new_group_usage, calling_gid, 1, 0, 0 );
-      eventfs_usage_put( &eventfs->group_usages, new_group_usage );
+      // ordinary file, or a reader
+      return 0;
+   }
+   
+   if( handle == NULL ) {
+      return -ENOMEM;
+   }
+   
+   *handle_data = (void*)handle;
+   return 0;
+}
+
+
+// close a file.
+// closing a written .push handle publishes its message, and closing a staged file's creator handle publishes the file.
+// closing a written cursor handle moves the cursor.
+// return 0 on success 
+// return negative if the message could not be published (a .push message is discarded).
+// NOTE: the kernel ignores errors from release, so quotas are checked when the file is created or opened, not here.
+// what can still go wrong here is that the directory was reaped in the meantime (-ENOENT), or OOM (-ENOMEM).
+int eventfs_close( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* handle_data ) {
+   
+   eventfs_debug("eventfs_close(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
+   
+   int rc = 0;
+   struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
+   struct eventfs_file_handle* handle = (struct eventfs_file_handle*)handle_data;
+   off_t staged_size = 0;
+   
+   if( handle == NULL ) {
+      
+      // plain message; journal what was written to it, if anything
+      rc = eventfs_journal_log_data( eventfs, fskit_route_metadata_get_path( route_metadata ), fent );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_journal_log_data('%s') rc = %d\n", fskit_route_metadata_get_path( route_metadata ), rc );
+      }
+      
+      return 0;
+   }
+   
+   if( handle->type == EVENTFS_HANDLE_STAGED ) {
+      
+      rc = eventfs_staged_publish( eventfs, fskit_route_metadata_get_path( route_metadata ), fent, handle->owner, handle->group );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_staged_publish('%s') rc = %d\n", fskit_route_metadata_get_path( route_metadata ), rc );
+      }
+   }
+   else if( handle->type == EVENTFS_HANDLE_PUSH && handle->dirty ) {
+      
+      staged_size = handle->staged->size;
+      
+      rc = eventfs_push_publish( eventfs, fskit_route_metadata_get_path( route_metadata ), handle );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_push_publish('%s') rc = %d\n", fskit_route_metadata_get_path( route_metadata ), rc );
+         
+         if( handle->reserved ) {
+            
+            // its directory is gone, so there is no place to give back
+            eventfs_file_quota_refund( eventfs, handle->owner, handle->group );
+            handle->reserved = false;
+         }
+         
+         // give back the bytes we charged on write 
+         eventfs_quota_rlock( eventfs );
+         
+         if( eventfs_usage_lookup( eventfs->user_usages, handle->owner ) != NULL ) {
+            eventfs_usage_change_num_bytes( eventfs->user_usages, handle->owner, -staged_size );
+         }
+         
+         if( eventfs_usage_lookup( eventfs->group_usages, handle->group ) != NULL ) {
+            eventfs_usage_change_num_bytes( eventfs->group_usages, handle->group, -staged_size );
+         }
+         
+         eventfs_quota_unlock( eventfs );
+      }
+   }
+   else if( handle->type == EVENTFS_HANDLE_PUSH ) {
+      
+      // nothing to publish 
+      rc = eventfs_push_unbind( eventfs, fskit_route_metadata_get_path( route_metadata ), handle );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_push_unbind('%s') rc = %d\n", fskit_route_metadata_get_path( route_metadata ), rc );
+      }
+   }
+   else if( handle->type == EVENTFS_HANDLE_CURSOR && handle->dirty ) {
+      
+      rc = eventfs_cursor_commit( eventfs, fskit_route_metadata_get_path( route_metadata ), fent, handle );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_cursor_commit('%s') rc = %d\n", fskit_route_metadata_get_path( route_metadata ), rc );
+      }
+   }
+   
+   eventfs_file_handle_free( handle );
+   eventfs_safe_free( handle );
+   
+   return rc;
+}
+
+
+// flush a file.
+// fsync'ing a staged file publishes it early.
+// return 0 on success 
+// return negative if the file could not be published
+int eventfs_sync( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent ) {
+   
+   eventfs_debug("eventfs_sync(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
+   
+   struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
+   struct eventfs_file_inode* inode = NULL;
+   bool staged = false;
+   
+   fskit_entry_rlock( fent );
+   
+   inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( fent );
+   if( fskit_entry_get_type( fent ) == FSKIT_ENTRY_TYPE_FILE && inode != NULL ) {
+      
+      staged = ((inode->flags & EVENTFS_FILE_STAGED) != 0);
+   }
+   
+   fskit_entry_unlock( fent );
+   
+   if( !staged ) {
+      return 0;
    }
    
-   return rc;
+   return eventfs_staged_publish( eventfs, fskit_route_metadata_get_path( route_metadata ), fent, eventfs_caller_uid( eventfs ), eventfs_caller_gid( eventfs ) );
 }
 
 
@@ -261,7 +1661,7 @@ int eventfs_create( struct fskit_core* core, struct fskit_route_metadata* route_
 // return negative on failure to initialize the inode
 int eventfs_mkdir( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* dent, mode_t mode, void** inode_data ) {
    
-   eventfs_debug("eventfs_mkdir(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+   eventfs_debug("eventfs_mkdir(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
    
    int rc = 0;
    struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
@@ -277,6 +1677,12 @@ int eventfs_mkdir( struct fskit_core* core, struct fskit_route_metadata* route_m
        return -EPERM;
    }
    
+   if( strncmp( fskit_route_metadata_get_name( route_metadata ), EVENTFS_REAPED_PREFIX, strlen(EVENTFS_REAPED_PREFIX) ) == 0 ) {
+       
+       // reserved for dead directories on their way out
+       return -EPERM;
+   }
+   
    // NOTE: parent will be write-locked
    struct fskit_entry* parent = fskit_route_metadata_get_parent( route_metadata );
    
@@ -285,9 +1691,9 @@ int eventfs_mkdir( struct fskit_core* core, struct fskit_route_metadata* route_m
    char name[FSKIT_FILESYSTEM_NAMEMAX+1];
    memset( name, 0, FSKIT_FILESYSTEM_NAMEMAX + 1 );
    
-   pid_t calling_tid = fskit_fuse_get_pid();
-   uid_t calling_uid = fskit_fuse_get_uid( eventfs->fuse_state );
-   gid_t calling_gid = fskit_fuse_get_gid( eventfs->fuse_state );
+   pid_t calling_tid = eventfs_caller_pid();
+   uid_t calling_uid = eventfs_caller_uid( eventfs );
+   gid_t calling_gid = eventfs_caller_gid( eventfs );
    
    uint64_t dir_quota_user = eventfs->config.default_dir_quota;
    uint64_t dir_quota_group = eventfs->config.default_dir_quota;
@@ -332,6 +1738,14 @@ int eventfs_mkdir( struct fskit_core* core, struct fskit_route_metadata* route_m
    eventfs_quota_unlock( eventfs );
    
    // check quotas
+   if( dir_quota_user <= num_dirs_user && eventfs_owner_reclaim( eventfs, parent, calling_uid, NULL ) > 0 ) {
+       
+       // got some back from the user's dead directories; try again
+       eventfs_quota_rlock( eventfs );
+       num_dirs_user = eventfs_usage_get_num_dirs( eventfs->user_usages, calling_uid );
+       eventfs_quota_unlock( eventfs );
+   }
+   
    if( dir_quota_user <= num_dirs_user ) {
     
        // user has too many dirs
@@ -387,7 +1801,7 @@ int eventfs_mkdir( struct fskit_core* core, struct fskit_route_metadata* route_m
    }
    
    // set up directory state
-   rc = eventfs_dir_inode_init( inode, calling_tid, EVENTFS_VERIFY_DEFAULT );
+   rc = eventfs_dir_inode_init( inode, calling_tid, eventfs->config.verify_fast ? EVENTFS_VERIFY_FAST : EVENTFS_VERIFY_DEFAULT );
    if( rc != 0 ) {
        
        // phantom process?
@@ -397,34 +1811,46 @@ int eventfs_mkdir( struct fskit_core* core, struct fskit_route_metadata* route_m
        return rc;
    }
    
-   *inode_data = (void*)inode;
+   // index it under its creator, so it can be reaped as soon as the creator exits
+   inode->path = strdup( fskit_route_metadata_get_path( route_metadata ) );
+   if( inode->path == NULL ) {
+       
+       // OOM
+       eventfs_dir_inode_free( core, inode );
+       eventfs_safe_free( new_user_usage );
+       eventfs_safe_free( new_group_usage );
+       eventfs_safe_free( inode );
+       return -ENOMEM;
+   }
    
-   int cur_mkdir_count = __sync_add_and_fetch( &g_mkdir_count, 1 );
+   eventfs_proc_add_dir( inode->proc, inode );
    
-   if( cur_mkdir_count == REAP_FREQUENCY ) {
-       
-       cur_mkdir_count = __sync_sub_and_fetch( &g_mkdir_count, REAP_FREQUENCY );
+   if( eventfs->config.fate_cgroup ) {
        
-       if( cur_mkdir_count < REAP_FREQUENCY ) {
-          
-          // Either the process that decremented g_mkdir_count gets this far, 
-          // or it doesn't. If it doesn't--that is, g_mkdir_count gets incremented 
-          // more than REAP_FREQUENCY times between this process's __sync_add_and_fetch
-          // and its subsequent __sync_sub_and_fetch, then it means at least one 
-          // other process will have observed cur_mkdir_count == REAP_FREQUENCY,
-          // and exactly one of them will observe cur_mkdir_count < REAP_FREQUENCY.
-          // The point is, a high volume of mkdirs should not starve the reaper thread.
-          eventfs_debug("%s", "Reap dead directories\n" );
-          
-          rc = eventfs_deferred_reap( eventfs );
-          if( rc != 0 ) {
-            
-              eventfs_error("eventfs_deferred_reap rc = %d\n", rc );
-              rc = 0;
-          }
+       // share fate with the creator's cgroup instead
+       inode->cgroup = eventfs_cgroup_get( &eventfs->cgroups, calling_tid, &rc );
+       if( inode->cgroup == NULL ) {
+           
+           eventfs_debug("'%s' will share fate with its creator %d, since its cgroup can't be watched (rc = %d)\n", inode->path, calling_tid, rc );
+           rc = 0;
+       }
+       else {
+           
+           eventfs_cgroup_add_dir( &eventfs->cgroups, inode->cgroup, inode );
        }
    }
    
+   *inode_data = (void*)inode;
+   
+   // sweep for dead creators every so often.
+   // how often depends on how many dead directories the last sweeps turned up, and on whether we hear about exits anyway.
+   rc = eventfs_deferred_reap_if_due( eventfs );
+   if( rc != 0 ) {
+     
+       eventfs_error("eventfs_deferred_reap_if_due rc = %d\n", rc );
+       rc = 0;
+   }
+   
    // update usages 
    if( new_user_usage == NULL ) {
       
@@ -446,6 +1872,9 @@ int eventfs_mkdir( struct fskit_core* core, struct fskit_route_metadata* route_m
       eventfs_usage_put( &eventfs->group_usages, new_group_usage );
    }
    
+   // index it under its user too, so the user can reclaim it if it dies while the user is at quota
+   eventfs_owner_add_dir( eventfs, calling_uid, inode );
+   
    // success!
    return rc;
 }
@@ -457,66 +1886,93 @@ int eventfs_mkdir( struct fskit_core* core, struct fskit_route_metadata* route_m
 // return -ENOSYS if the inode is not initialize (should *never* happen)
 int eventfs_read( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
    
-   eventfs_debug("eventfs_read(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+   eventfs_debug("eventfs_read(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
    
    struct eventfs_file_inode* inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( fent );
-   int num_read = 0;
    
    if( inode == NULL ) {
       return -ENOSYS;
    }
    
-   if( offset >= inode->size ) {
-      return 0;
-   }
-   
-   // copy data out, if we have any 
-   if( inode->contents != NULL ) {
-      
-      num_read = buflen;
-      
-      if( (unsigned)(offset + buflen) >= inode->size ) {
-         
-         num_read = inode->size - offset;
-         
-         if( num_read < 0 ) {
-            num_read = 0;
-         }
-      }
-   }
-   
-   if( num_read > 0 ) {
+   if( inode->flags & EVENTFS_FILE_CURSOR ) {
       
-      memcpy( buf, inode->contents + offset, num_read );
+      // next unread file's name
+      return eventfs_cursor_read( inode->cursor, buf, buflen, offset );
    }
    
-   return num_read;
+   return eventfs_file_inode_read( inode, buf, buflen, offset );
 }
 
 // write to a file 
+// writes to a .push handle go to its staged message, and are charged to the handle's owner.
+// writes to a cursor handle name the file to move the cursor past.
 // return the number of bytes written, and expand the file in RAM if we write off the edge.
 // return -ENOSYS if for some reason we don't have an inode (should *never* happen)
 // return -ENOMEM on OOM
 // NOTE: we use FSKIT_INODE_SEQUENTIAL, so fent will be write-locked
 int eventfs_write( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
    
-   eventfs_debug("eventfs_write(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+   eventfs_debug("eventfs_write(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
    
+   int rc = 0;
    struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
    struct eventfs_file_inode* inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( fent );
-   size_t new_contents_len = inode->contents_len;
+   struct eventfs_file_handle* push_handle = NULL;
    
    if( inode == NULL ) {
       return -ENOSYS;
    }
    
-   off_t cur_size = inode->size;
-   int64_t add_to_usage = (cur_size >= offset + buflen ? 0 : (offset + buflen) - cur_size);
-   
-   pid_t calling_tid = fskit_fuse_get_pid();
    uid_t owner_uid = fskit_entry_get_owner( fent );
    gid_t owner_gid = fskit_entry_get_group( fent );
    
+   if( inode->flags & EVENTFS_FILE_LEASE ) {
+      
+      // holds no data; opening it already renewed the lease
+      return buflen;
+   }
+   
+   if( inode->flags & EVENTFS_FILE_CURSOR ) {
+      
+      // remember which file to move past, until close.
+      // this is at most a file name, so it is not charged.
+      push_handle = (struct eventfs_file_handle*)handle_data;
+      if( push_handle == NULL || push_handle->type != EVENTFS_HANDLE_CURSOR ) {
+         return -EBADF;
+      }
+      
+      if( offset + buflen > FSKIT_FILESYSTEM_NAMEMAX + 1 ) {
+         return -ENAMETOOLONG;
+      }
+      
+      rc = eventfs_file_inode_write( push_handle->staged, buf, buflen, offset );
+      if( rc < 0 ) {
+         return rc;
+      }
+      
+      push_handle->dirty = true;
+      return buflen;
+   }
+   
+   if( inode->flags & EVENTFS_FILE_PUSH ) {
+      
+      // stage the message 
+      push_handle = (struct eventfs_file_handle*)handle_data;
+      if( push_handle == NULL || push_handle->type != EVENTFS_HANDLE_PUSH ) {
+         return -EBADF;
+      }
+      
+      inode = push_handle->staged;
+      owner_uid = push_handle->owner;
+      owner_gid = push_handle->group;
+   }
+   
+   off_t cur_size = inode->size;
+   off_t end = offset + (off_t)buflen;
+   int64_t add_to_usage = (cur_size >= end ? 0 : end - cur_size);
+   
+   pid_t calling_tid = eventfs_caller_pid();
+   
    uint64_t bytes_quota_user = eventfs->config.default_bytes_quota;
    uint64_t bytes_quota_group = eventfs->config.default_bytes_quota;
    
@@ -577,37 +2033,18 @@ int eventfs_write( struct fskit_core* core, struct fskit_route_metadata* route_m
        return -EDQUOT;
    }
    
-   if( new_contents_len == 0 ) {
-      new_contents_len = 1;
+   rc = eventfs_file_inode_write( inode, buf, buflen, offset );
+   if( rc < 0 ) {
+      return rc;
    }
    
-   // expand contents?
-   while( offset + buflen > new_contents_len ) {
-      new_contents_len *= 2;
+   if( push_handle != NULL ) {
+      push_handle->dirty = true;
    }
-   
-   if( new_contents_len > inode->contents_len ) {
-      
-      // expand
-      char* tmp = (char*)realloc( inode->contents, new_contents_len );
-      
-      if( tmp == NULL ) {
-         return -ENOMEM;
-      }
-      
-      inode->contents = tmp;
-      
-      memset( inode->contents + inode->contents_len, 0, new_contents_len - inode->contents_len );
+   else {
       
-      inode->contents_len = new_contents_len;
-   }
-   
-   // write in 
-   memcpy( inode->contents + offset, buf, buflen );
-   
-   // expand size?
-   if( (unsigned)(offset + buflen) > inode->size ) {
-      inode->size = offset + buflen;
+      // journal on close
+      inode->flags |= EVENTFS_FILE_DIRTY;
    }
    
    // update usages 
@@ -632,20 +2069,26 @@ int eventfs_write( struct fskit_core* core, struct fskit_route_metadata* route_m
 // use under the FSKIT_INODE_SEQUENTIAL consistency discipline--the entry will be write-locked when we call this method.
 int eventfs_truncate( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, off_t new_size, void* inode_data ) {
    
-   eventfs_debug("eventfs_truncate(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+   eventfs_debug("eventfs_truncate(%s) from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
    
+   int rc = 0;
    struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
    struct eventfs_file_inode* inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( fent );
-   size_t new_contents_len = inode->contents_len;
    
    if( inode == NULL ) {
       return -ENOSYS;
    }
    
+   if( inode->flags & (EVENTFS_FILE_PUSH | EVENTFS_FILE_CURSOR | EVENTFS_FILE_LEASE) ) {
+      
+      // .push, cursors, and .lease never hold data themselves (e.g. O_TRUNC on open)
+      return 0;
+   }
+   
    off_t cur_size = inode->size;
    int64_t add_to_usage = new_size - cur_size;
    
-   pid_t calling_tid = fskit_fuse_get_pid();
+   pid_t calling_tid = eventfs_caller_pid();
    uid_t owner_uid = fskit_entry_get_owner( fent );
    gid_t owner_gid = fskit_entry_get_group( fent );
    
@@ -707,37 +2150,12 @@ int eventfs_truncate( struct fskit_core* core, struct fskit_route_metadata* rout
        return -EDQUOT;
    }
    
-   // expand?
-   if( (unsigned)new_size >= inode->contents_len ) {
-      
-      if( new_contents_len == 0 ) {
-         new_contents_len = 1;
-      }
-      
-      while( (unsigned)new_size > new_contents_len ) {
-         
-         new_contents_len *= 2;
-      }
-      
-      char* tmp = (char*)realloc( inode->contents, new_contents_len );
-      
-      if( tmp == NULL ) {
-         return -ENOMEM;
-      }
-      
-      inode->contents = tmp;
-      
-      memset( inode->contents + inode->contents_len, 0, new_contents_len - inode->contents_len );
-      
-      inode->contents_len = new_contents_len;
-   }
-   else {
-      
-      memset( inode->contents + new_size, 0, inode->contents_len - new_size );
+   rc = eventfs_file_inode_truncate( inode, new_size );
+   if( rc != 0 ) {
+      return rc;
    }
    
-   // new size 
-   inode->size = new_size;
+   inode->flags |= EVENTFS_FILE_DIRTY;
    
    // update usages 
    if( !unknown_user ) {
@@ -760,7 +2178,7 @@ int eventfs_truncate( struct fskit_core* core, struct fskit_route_metadata* rout
 // NOTE: fent cannot be locked.
 int eventfs_remove_file( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* inode_data, bool destroy ) {
    
-   eventfs_debug("eventfs_remove_file('%s', destroy=%d) from %d\n", fskit_route_metadata_get_path( route_metadata ), destroy, fskit_fuse_get_pid() );
+   eventfs_debug("eventfs_remove_file('%s', destroy=%d) from %d\n", fskit_route_metadata_get_path( route_metadata ), destroy, eventfs_caller_pid() );
    
    int rc = 0;
    struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
@@ -776,10 +2194,18 @@ int eventfs_remove_file( struct fskit_core* core, struct fskit_route_metadata* r
    gid_t owner_gid = fskit_entry_get_group( fent );
    off_t cur_size = 0;
    int type = fskit_entry_get_type( fent );
+   bool is_push = false;
+   bool is_staged = false;
+   bool is_cursor = false;
+   bool is_lease = false;
    
    if( inode != NULL ) {
        
        cur_size = inode->size;
+       is_lease = ((inode->flags & EVENTFS_FILE_LEASE) != 0);
+       is_push = ((inode->flags & EVENTFS_FILE_PUSH) != 0);
+       is_staged = ((inode->flags & EVENTFS_FILE_STAGED) != 0);
+       is_cursor = ((inode->flags & EVENTFS_FILE_CURSOR) != 0);
    }
    
    memset( name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
@@ -805,7 +2231,39 @@ int eventfs_remove_file( struct fskit_core* core, struct fskit_route_metadata* r
                 return -ENOMEM;
             }
             
-            if( !destroy ) {
+            if( is_push ) {
+                
+                // .push is not in the deque.  It gets re-created on demand.
+                if( fent == dir_inode->fent_push ) {
+                    dir_inode->fent_push = NULL;
+                }
+                
+                if( destroy ) {
+                    eventfs_file_inode_free( inode );
+                    eventfs_safe_free( inode );
+                }
+            }
+            else if( is_cursor ) {
+                
+                // unregister, and reclaim whatever this cursor was holding back
+                if( eventfs_dir_inode_cursor_remove( dir_inode, inode->cursor ) == 0 ) {
+                    
+                    rc = eventfs_dir_inode_cursor_reclaim( core, dir_path, dir_inode, parent );
+                }
+                
+                if( destroy ) {
+                    eventfs_file_inode_free( inode );
+                    eventfs_safe_free( inode );
+                }
+            }
+            else if( is_staged || is_lease ) {
+                
+                // never joined the deque (an unlinked .lease just lets the lease run out)
+                if( destroy ) {
+                    eventfs_limbo_add( eventfs, inode );
+                }
+            }
+            else if( !destroy ) {
                 
                 // only detaching...
                 if( fent == dir_inode->fent_head ) {
@@ -824,6 +2282,10 @@ int eventfs_remove_file( struct fskit_core* core, struct fskit_route_metadata* r
                     
                     // detach a file in the middle 
                     rc = eventfs_dir_inode_remove( core, dir_path, dir_inode, parent, name );
+                    
+                    if( rc == 0 && type == FSKIT_ENTRY_TYPE_FILE ) {
+                        eventfs_journal_log_remove( eventfs, path, dir_inode );
+                    }
                 }
             }
             
@@ -842,8 +2304,9 @@ int eventfs_remove_file( struct fskit_core* core, struct fskit_route_metadata* r
                     eventfs_dir_inode_remove( core, dir_path, dir_inode, parent, name );
                     
                     if( old_file != NULL ) {
-                        eventfs_file_inode_free( old_file );
-                        eventfs_safe_free( old_file );
+                        
+                        // free the body later, outside the directory lock
+                        eventfs_limbo_add( eventfs, old_file );
                     }
                 }
             }
@@ -853,6 +2316,17 @@ int eventfs_remove_file( struct fskit_core* core, struct fskit_route_metadata* r
         else {
             
             eventfs_debug("Parent of '%s' already reaped\n", fskit_route_metadata_get_path( route_metadata ));
+            
+            if( is_cursor ) {
+                
+                // don't leave it behind in the dead directory 
+                eventfs_dir_inode_cursor_remove( dir_inode, inode->cursor );
+                
+                if( destroy ) {
+                    eventfs_file_inode_free( inode );
+                    eventfs_safe_free( inode );
+                }
+            }
         }
    }
    else if( destroy ) {
@@ -861,13 +2335,12 @@ int eventfs_remove_file( struct fskit_core* core, struct fskit_route_metadata* r
        eventfs_debug("reclaim %s\n", path );
        
        if( inode != NULL ) {
-           eventfs_file_inode_free( inode );
-           eventfs_safe_free( inode );
+           eventfs_limbo_add( eventfs, inode );
        }
    }
    
-   // debit usages
-   if( type == FSKIT_ENTRY_TYPE_FILE ) {
+   // debit usages (.push, cursors, and .lease are never charged)
+   if( type == FSKIT_ENTRY_TYPE_FILE && !is_push && !is_cursor && !is_lease ) {
        eventfs_quota_rlock( eventfs );
         
        if( eventfs_usage_lookup( eventfs->user_usages, owner_uid ) != NULL ) {
@@ -899,17 +2372,22 @@ int eventfs_remove_file( struct fskit_core* core, struct fskit_route_metadata* r
 // return -ENOENT if the directory no longer exists.
 int eventfs_destroy_dir( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* dent, void* inode_data ) {
    
-   eventfs_debug("eventfs_destroy_dir('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+   eventfs_debug("eventfs_destroy_dir('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
    
    struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
    struct eventfs_dir_inode* inode = (struct eventfs_dir_inode*)inode_data;
    
    uid_t owner_uid = fskit_entry_get_owner( dent );
    gid_t owner_gid = fskit_entry_get_group( dent );
+   bool credited = false;
    
    // blow away the inode
    if( inode != NULL ) {
       
+      credited = inode->quota_credited;
+      
+      eventfs_journal_log_rmdir( eventfs, fskit_route_metadata_get_path( route_metadata ), inode );
+      
       eventfs_dir_inode_free( core, inode );
       eventfs_safe_free( inode );
       
@@ -917,6 +2395,12 @@ int eventfs_destroy_dir( struct fskit_core* core, struct fskit_route_metadata* r
       fskit_entry_set_user_data( dent, NULL );
    }
    
+   if( credited ) {
+      
+      // already given back when it was reclaimed
+      return 0;
+   }
+   
    // debit usages
    eventfs_quota_rlock( eventfs );
    
@@ -942,11 +2426,12 @@ int eventfs_destroy_dir( struct fskit_core* core, struct fskit_route_metadata* r
 // return -ENONET if the directory no longer eists 
 int eventfs_destroy( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* inode_data ) {
     
-    eventfs_debug("eventfs_destroy('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+    eventfs_debug("eventfs_destroy('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
     
     fskit_entry_rlock( fent );
     
     int type = fskit_entry_get_type( fent );
+    uint64_t file_id = fskit_entry_get_file_id( fent );
     
     fskit_entry_unlock( fent );
     
@@ -954,6 +2439,9 @@ int eventfs_destroy( struct fskit_core* core, struct fskit_route_metadata* route
         return eventfs_destroy_dir( core, route_metadata, fent, inode_data );
     }
     else if( type == FSKIT_ENTRY_TYPE_FILE || type == FSKIT_ENTRY_TYPE_LNK ) {
+        
+        // .push messages and head and tail symlinks got their numbers from us
+        eventfs_inode_number_release( file_id );
         return eventfs_remove_file( core, route_metadata, fent, inode_data, true );
     }
     else {
@@ -967,7 +2455,7 @@ int eventfs_destroy( struct fskit_core* core, struct fskit_route_metadata* route
 // return -ENONET if the directory no longer eists 
 int eventfs_detach( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* inode_data ) {
     
-    eventfs_debug("eventfs_detach('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+    eventfs_debug("eventfs_detach('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
     
     fskit_entry_rlock( fent );
     
@@ -987,6 +2475,62 @@ int eventfs_detach( struct fskit_core* core, struct fskit_route_metadata* route_
     }
 }
 
+// reap a directory whose creator (or cgroup) is known to be gone, without looking at any other directory.
+// it is left alone if it is sticky, or if it is still valid (e.g. it has since been recreated by a process that is still running).
+// return 0 on success, or if there is nothing to do
+// return negative on error
+int eventfs_dir_reap( struct eventfs_state* eventfs, char const* path ) {
+   
+   int rc = 0;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* inode = NULL;
+   
+   dent = fskit_entry_resolve_path( eventfs->core, path, 0, 0, true, &rc );
+   if( dent == NULL ) {
+      
+      // already gone?
+      return (rc == -ENOENT ? 0 : rc);
+   }
+   
+   if( fskit_entry_get_type( dent ) != FSKIT_ENTRY_TYPE_DIR ) {
+      
+      fskit_entry_unlock( dent );
+      return 0;
+   }
+   
+   inode = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   if( inode == NULL || inode->deleted || eventfs_dir_inode_is_valid( inode, eventfs_dir_verify_discipline( eventfs->core, path, dent, inode ) ) != 0 ) {
+      
+      fskit_entry_unlock( dent );
+      return 0;
+   }
+   
+   rc = fskit_fgetxattr( eventfs->core, path, dent, "user.eventfs_sticky", NULL, 0 );
+   if( rc >= 0 ) {
+      
+      // sticky set 
+      fskit_entry_unlock( dent );
+      return 0;
+   }
+   
+   // flag deleted, and garbage-collect
+   inode->deleted = true;
+   
+   rc = eventfs_deferred_remove( eventfs, path, dent );
+   fskit_entry_unlock( dent );
+   
+   if( rc != 0 ) {
+      
+      eventfs_error("eventfs_deferred_remove('%s') rc = %d\n", path, rc );
+   }
+   else {
+      
+      eventfs_debug("Detached '%s' because its creator exited\n", path );
+   }
+   
+   return rc;
+}
+
 // stat an entry.
 // for non-root diretories, garbage-collect both it and and its children if the process that created it died.
 // return 0 on success 
@@ -994,7 +2538,7 @@ int eventfs_detach( struct fskit_core* core, struct fskit_route_metadata* route_
 // return -EIO if the inode is invalid 
 int eventfs_stat( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, struct stat* sb ) {
    
-   eventfs_debug("eventfs_stat('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+   eventfs_debug("eventfs_stat('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
    
    int rc = 0;
    struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
@@ -1055,13 +2599,13 @@ int eventfs_stat( struct fskit_core* core, struct fskit_route_metadata* route_me
            rc = 0;
        }
        
-       pid_t pid = pstat_get_pid( inode->ps );
+       pid_t pid = pstat_get_pid( eventfs_proc_get_pstat( inode->proc ) );
    
-       rc = eventfs_dir_inode_is_valid( inode );
+       rc = eventfs_dir_inode_is_valid( inode, eventfs_dir_verify_discipline( core, path, fent, inode ) );
        if( rc < 0 ) {
             
             char path[PATH_MAX+1];
-            pstat_get_path( inode->ps, path );
+            pstat_get_path( eventfs_proc_get_pstat( inode->proc ), path );
             
             eventfs_error( "eventfs_dir_inode_is_valid(path=%s, pid=%d) rc = %d\n", path, pid, rc );
             
@@ -1111,7 +2655,7 @@ int eventfs_stat( struct fskit_core* core, struct fskit_route_metadata* route_me
 // return -EPERM if we tried to rename the head or tail symlinks
 int eventfs_rename( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* old_fent, char const* new_path, struct fskit_entry* new_fent ) {
     
-    eventfs_debug("eventfs_rename('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), fskit_fuse_get_pid() );
+    eventfs_debug("eventfs_rename('%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), eventfs_caller_pid() );
     
     int rc = 0;
     struct eventfs_dir_inode* dir = NULL;
@@ -1157,11 +2701,13 @@ int eventfs_rename( struct fskit_core* core, struct fskit_route_metadata* route_
 // return -ENOMEM on OOM 
 int eventfs_link( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char const* new_path ) {
     
-    eventfs_debug("eventfs_link('%s', '%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), new_path, fskit_fuse_get_pid() );
+    eventfs_debug("eventfs_link('%s', '%s') from %d\n", fskit_route_metadata_get_path( route_metadata ), new_path, eventfs_caller_pid() );
     
     int rc = 0;
+    struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
     struct eventfs_dir_inode* dir = NULL;
     struct eventfs_file_inode* file = NULL;
+    char* dir_path = NULL;
     char new_name[FSKIT_FILESYSTEM_NAMEMAX+1];
     struct fskit_entry* parent = fskit_route_metadata_get_new_parent( route_metadata );
     
@@ -1181,7 +2727,35 @@ int eventfs_link( struct fskit_core* core, struct fskit_route_metadata* route_me
     memset( new_name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
     fskit_basename( new_path, new_name );
 
-    return eventfs_dir_inode_append( core, dir, parent, new_name );
+    rc = eventfs_dir_inode_append( core, dir, parent, new_name );
+    if( rc != 0 ) {
+        
+        return rc;
+    }
+    
+    dir_path = fskit_dirname( new_path, NULL );
+    if( dir_path == NULL ) {
+        
+        // lives until consumed
+        return 0;
+    }
+    
+    rc = eventfs_ttl_arm( eventfs, dir_path, parent, dir, NULL, NULL );
+    if( rc != 0 ) {
+        
+        eventfs_error("eventfs_ttl_arm('%s') rc = %d\n", dir_path, rc );
+        rc = 0;
+    }
+    
+    rc = eventfs_journal_log_append( eventfs, dir_path, parent, dir, fent, new_name, NULL );
+    if( rc != 0 ) {
+        
+        eventfs_error("eventfs_journal_log_append('%s') rc = %d\n", new_path, rc );
+        rc = 0;
+    }
+    
+    eventfs_safe_free( dir_path );
+    return rc;
 }
 
 
@@ -1190,7 +2764,7 @@ int eventfs_link( struct fskit_core* core, struct fskit_route_metadata* route_me
 // we need concurrent per-inode locking (i.e. read-lock the directory)
 int eventfs_readdir( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, struct fskit_dir_entry** dirents, size_t num_dirents ) {
    
-   eventfs_debug("eventfs_readdir(%s, %zu) from %d\n", fskit_route_metadata_get_path( route_metadata ), num_dirents, fskit_fuse_get_pid() );
+   eventfs_debug("eventfs_readdir(%s, %zu) from %d\n", fskit_route_metadata_get_path( route_metadata ), num_dirents, eventfs_caller_pid() );
    
    int rc = 0;
    struct fskit_entry* child = NULL;
@@ -1200,8 +2774,8 @@ int eventfs_readdir( struct fskit_core* core, struct fskit_route_metadata* route
    
    struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
    
-   uid_t calling_uid = fskit_fuse_get_uid( eventfs->fuse_state );
-   gid_t calling_gid = fskit_fuse_get_gid( eventfs->fuse_state );
+   uid_t calling_uid = eventfs_caller_uid( eventfs );
+   gid_t calling_gid = eventfs_caller_gid( eventfs );
    
    // skip non-directories 
    if( fskit_entry_get_type( fent ) != FSKIT_ENTRY_TYPE_DIR ) {
@@ -1220,6 +2794,7 @@ int eventfs_readdir( struct fskit_core* core, struct fskit_route_metadata* route
    }
    
    int omitted_idx = 0;
+   uint64_t num_dead = 0;
    
    // find dead directories and (1) omit them and (2) reap them
    for( unsigned int i = 0; i < num_dirents; i++ ) {
@@ -1278,14 +2853,14 @@ int eventfs_readdir( struct fskit_core* core, struct fskit_route_metadata* route
       }
       
       // is this file still valid?
-      int valid = eventfs_dir_inode_is_valid( inode );
+      int valid = eventfs_dir_inode_is_valid( inode, eventfs_dir_verify_discipline( core, path, child, inode ) );
       
       if( valid < 0 ) {
          
          char path[PATH_MAX+1];
-         pstat_get_path( inode->ps, path );
+         pstat_get_path( eventfs_proc_get_pstat( inode->proc ), path );
          
-         eventfs_error( "eventfs_dir_inode_is_valid(path=%s, pid=%d) rc = %d\n", path, pstat_get_pid( inode->ps ), valid );
+         eventfs_error( "eventfs_dir_inode_is_valid(path=%s, pid=%d) rc = %d\n", path, pstat_get_pid( eventfs_proc_get_pstat( inode->proc ) ), valid );
          
          valid = 0;
       }
@@ -1320,6 +2895,7 @@ int eventfs_readdir( struct fskit_core* core, struct fskit_route_metadata* route
       
          // flag deleted
          inode->deleted = true;
+         num_dead++;
          
          uint64_t child_id = fskit_entry_get_file_id( child );
          char* child_fp = fskit_fullpath( fskit_route_metadata_get_path( route_metadata ), dirents[i]->name, NULL );
@@ -1347,6 +2923,12 @@ int eventfs_readdir( struct fskit_core* core, struct fskit_route_metadata* route
       }
    }
    
+   if( num_dead > 0 ) {
+      
+      // tell the sweep scheduler it's worth sweeping again soon
+      eventfs_deferred_reap_found( eventfs, num_dead );
+   }
+   
    for( int i = 0; i < omitted_idx; i++ ) {
       
       fskit_readdir_omit( dirents, omitted[i] );
@@ -1455,6 +3037,20 @@ int eventfs_getopts( struct eventfs_opts* opts, int* argc, char** argv ) {
 
 
 // run! 
+// turn the timer wheel, flush the journal, and free message bodies in limbo.
+// runs on the deferred work queue, once per timer tick.
+// always succeeds
+static int eventfs_timers_tick( struct eventfs_wreq* wreq, void* cls ) {
+   
+   struct eventfs_state* eventfs = (struct eventfs_state*)cls;
+   
+   eventfs_timer_wheel_advance( &eventfs->timers, eventfs_timer_now() );
+   eventfs_journal_sync( &eventfs->journal );
+   eventfs_limbo_drain( &eventfs->limbo );
+   return 0;
+}
+
+
 int main( int argc, char** argv ) {
    
    int rc = 0;
@@ -1462,6 +3058,7 @@ int main( int argc, char** argv ) {
    struct fskit_fuse_state* state = NULL;
    struct fskit_core* core = NULL;
    struct eventfs_state eventfs;
+   bool restored = false;
    struct eventfs_opts opts;
    
    state = fskit_fuse_state_new();
@@ -1499,6 +3096,37 @@ int main( int argc, char** argv ) {
       exit(1);
    }
    
+   rc = eventfs_journal_init( &eventfs.journal );
+   if( rc != 0 ) {
+      fprintf(stderr, "eventfs_journal_init rc = %d\n", rc );
+      exit(1);
+   }
+   
+   rc = eventfs_cgroup_table_init( &eventfs.cgroups, &eventfs );
+   if( rc != 0 ) {
+      fprintf(stderr, "eventfs_cgroup_table_init rc = %d\n", rc );
+      exit(1);
+   }
+   
+   // expire messages with TTLs
+   rc = eventfs_timer_wheel_init( &eventfs.timers );
+   if( rc != 0 ) {
+      fprintf(stderr, "eventfs_timer_wheel_init rc = %d\n", rc );
+      exit(1);
+   }
+   
+   rc = eventfs_reaper_init( &eventfs.reaper, &eventfs );
+   if( rc != 0 ) {
+      fprintf(stderr, "eventfs_reaper_init rc = %d\n", rc );
+      exit(1);
+   }
+   
+   rc = eventfs_wq_set_tick( eventfs.deferred_wq, EVENTFS_TIMER_TICK_MS, eventfs_timers_tick, &eventfs );
+   if( rc != 0 ) {
+      fprintf(stderr, "eventfs_wq_set_tick rc = %d\n", rc );
+      exit(1);
+   }
+   
    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
    rc = fuse_parse_cmdline( &args, &eventfs.mountpoint, NULL, NULL );
    if( eventfs.mountpoint == NULL ) {
@@ -1506,8 +3134,8 @@ int main( int argc, char** argv ) {
       exit(1);
    }
    
-   // automatically reap child processes 
-   signal(SIGCHLD, SIG_IGN);
+   // child processes (sweeps) are reaped by whoever started them, so their pids can't be reused under them
+   signal(SIGCHLD, SIG_DFL);
    
    // set up fskit state
    rc = fskit_fuse_init( state, &eventfs );
@@ -1531,6 +3159,21 @@ int main( int argc, char** argv ) {
       exit(1);
    }
    
+   rc = pthread_mutex_init( &eventfs.owner_lock, NULL );
+   if( rc != 0 ) {
+      fprintf(stderr, "pthread_mutex_init rc = %d\n", rc );
+      exit(1);
+   }
+   
+   // tie directories to cgroups, if asked
+   if( eventfs.config.fate_cgroup ) {
+      
+      rc = eventfs_cgroup_table_start( &eventfs.cgroups );
+      if( rc != 0 ) {
+         fprintf(stderr, "WARN: eventfs_cgroup_table_start rc = %d; directories will share fate with their creators instead\n", rc );
+      }
+   }
+   
    // make sure the fs can access its methods through the VFS
    fskit_fuse_setting_enable( state, FSKIT_FUSE_SET_FS_ACCESS );
    
@@ -1553,6 +3196,24 @@ int main( int argc, char** argv ) {
       exit(1);
    }
    
+   rh = fskit_route_open( core, FSKIT_ROUTE_ANY, eventfs_open, FSKIT_CONCURRENT );
+   if( rh < 0 ) {
+      fprintf(stderr, "fskit_route_open(%s) rc = %d\n", FSKIT_ROUTE_ANY, rh );
+      exit(1);
+   }
+   
+   rh = fskit_route_close( core, FSKIT_ROUTE_ANY, eventfs_close, FSKIT_CONCURRENT );
+   if( rh < 0 ) {
+      fprintf(stderr, "fskit_route_close(%s) rc = %d\n", FSKIT_ROUTE_ANY, rh );
+      exit(1);
+   }
+   
+   rh = fskit_route_sync( core, FSKIT_ROUTE_ANY, eventfs_sync, FSKIT_CONCURRENT );
+   if( rh < 0 ) {
+      fprintf(stderr, "fskit_route_sync(%s) rc = %d\n", FSKIT_ROUTE_ANY, rh );
+      exit(1);
+   }
+   
    rh = fskit_route_read( core, FSKIT_ROUTE_ANY, eventfs_read, FSKIT_INODE_CONCURRENT );
    if( rh < 0 ) {
       fprintf(stderr, "fskit_route_read(%s) rc = %d\n", FSKIT_ROUTE_ANY, rh );
@@ -1612,6 +3273,41 @@ int main( int argc, char** argv ) {
    // set the root to be owned by the effective UID and GID of user
    fskit_chown( core, "/", 0, 0, geteuid(), getegid() );
    
+   // pick up where the last eventfs left off, if it shut down cleanly
+   if( eventfs.config.snapshot_path != NULL ) {
+      
+      rc = eventfs_journal_replay( &eventfs, eventfs.config.snapshot_path );
+      if( rc != 0 ) {
+         fprintf(stderr, "eventfs_journal_replay('%s') rc = %d\n", eventfs.config.snapshot_path, rc );
+         exit(1);
+      }
+      
+      // consume it, so a crash later on can't bring back stale state
+      if( unlink( eventfs.config.snapshot_path ) == 0 ) {
+         restored = true;
+      }
+   }
+   
+   // bring back sticky directories, and start journaling them 
+   if( eventfs.config.journal_path != NULL ) {
+      
+      if( !restored ) {
+         
+         // the snapshot is at least as new as the journal, so only replay the journal after a crash
+         rc = eventfs_journal_replay( &eventfs, eventfs.config.journal_path );
+         if( rc != 0 ) {
+            fprintf(stderr, "eventfs_journal_replay('%s') rc = %d\n", eventfs.config.journal_path, rc );
+            exit(1);
+         }
+      }
+      
+      rc = eventfs_journal_checkpoint( &eventfs, eventfs.config.journal_path );
+      if( rc != 0 ) {
+         fprintf(stderr, "eventfs_journal_checkpoint('%s') rc = %d\n", eventfs.config.journal_path, rc );
+         exit(1);
+      }
+   }
+   
    // begin taking deferred requests 
    rc = eventfs_wq_start( eventfs.deferred_wq );
    if( rc != 0 ) {
@@ -1619,18 +3315,49 @@ int main( int argc, char** argv ) {
       exit(1);
    }
    
+   // find out about dead creators as soon as they exit, if the kernel will tell us
+   rc = eventfs_exitwatch_start( &eventfs.exitwatch, &eventfs );
+   if( rc != 0 ) {
+      fprintf(stderr, "WARN: process connector unavailable (rc = %d); dead creators will only be found by sweeping\n", rc );
+   }
+   
    // run 
    rc = fskit_fuse_main( state, argc, argv );
    
-   // shutdown
+   // shutdown.
+   // stop the watchers and the work queue first, so none of them touches a dead core
+   eventfs_cgroup_table_stop( &eventfs.cgroups );
+   eventfs_exitwatch_stop( &eventfs.exitwatch );
+   eventfs_wq_stop( eventfs.deferred_wq );
+   
+   // nothing will drain limbo from here on, so free message bodies as they go
+   eventfs_limbo_stop( &eventfs.limbo );
+   
+   // save everything for the next eventfs
+   if( eventfs.config.snapshot_path != NULL ) {
+      
+      int snapshot_rc = eventfs_journal_snapshot( &eventfs, eventfs.config.snapshot_path );
+      if( snapshot_rc != 0 ) {
+         fprintf(stderr, "eventfs_journal_snapshot('%s') rc = %d\n", eventfs.config.snapshot_path, snapshot_rc );
+      }
+   }
+   
+   // tearing down the core is not consumption, so stop journaling first
+   eventfs_journal_close( &eventfs.journal );
+   
    fskit_fuse_shutdown( state, NULL );
    fskit_fuse_state_free( state );
    
-   eventfs_wq_stop( eventfs.deferred_wq );
    eventfs_wq_free( eventfs.deferred_wq );
    eventfs_safe_free( eventfs.deferred_wq );
    
+   eventfs_timer_wheel_free( &eventfs.timers );
+   eventfs_reaper_free( &eventfs.reaper );
+   eventfs_cgroup_table_free( &eventfs.cgroups );
+   pthread_mutex_destroy( &eventfs.journal.lock );
+   
    pthread_rwlock_destroy( &eventfs.quota_lock );
+   pthread_mutex_destroy( &eventfs.owner_lock );
    eventfs_quota_free( eventfs.user_quotas );
    eventfs_quota_free( eventfs.group_quotas );
    eventfs_usage_free( eventfs.user_usages );
@@ -32,6 +32,41 @@
 #include "util.h"
 #include "wq.h"
 #include "quota.h"
+#include "timer.h"
+#include "ttl.h"
+#include "lease.h"
+#include "limbo.h"
+#include "journal.h"
+#include "exitwatch.h"
+#include "cgroup.h"
+
+// xattr that sets what happens when a producer creates a file in a full directory
+#define EVENTFS_XATTR_OVERFLOW          "user.eventfs_overflow"
+#define EVENTFS_OVERFLOW_BUF_LEN        32
+
+// xattr that overrides how thoroughly a directory's creator is checked (EVENTFS_VERIFY_NAME_*)
+#define EVENTFS_XATTR_VERIFY            "user.eventfs_verify"
+#define EVENTFS_VERIFY_BUF_LEN          32
+
+// how long a user at quota spends reclaiming its dead directories, at most how many it reclaims, and at most how many
+// of its directories it looks at, before giving up with EDQUOT
+#define EVENTFS_RECLAIM_BUDGET_MS       50
+#define EVENTFS_RECLAIM_MAX_DIRS        64
+#define EVENTFS_RECLAIM_SCAN_MAX        1024
+
+// overflow policies
+#define EVENTFS_OVERFLOW_REJECT         "reject"                // fail with EDQUOT (the default)
+#define EVENTFS_OVERFLOW_DROP_OLDEST    "drop-oldest"           // unlink the head to make room
+
+// a message waiting to be published through .push 
+struct eventfs_push_req {
+    
+    struct eventfs_file_handle* handle;         // the producer's handle, with the staged body
+    struct fskit_entry* fent;                   // entry to attach (NULL once attached)
+    int rc;                                     // outcome of publishing it
+    bool done;                                  // if true, then it has been published (or failed)
+    struct eventfs_push_req* next;
+};
 
 struct eventfs_state {
     
@@ -40,7 +75,26 @@ struct eventfs_state {
     struct eventfs_config config;
     struct eventfs_wq* deferred_wq;
     
+    // timers, driven by deferred_wq
+    struct eventfs_timer_wheel timers;
+    
+    // schedules sweeps for dead directories
+    struct eventfs_reaper reaper;
+    
+    // freed message bodies, waiting for deferred_wq to free them
+    struct eventfs_limbo limbo;
+    
+    // write-ahead journal for sticky directories 
+    struct eventfs_journal journal;
+    
+    // process exit events, so dead creators' directories go away without waiting for a sweep
+    struct eventfs_exitwatch exitwatch;
+    
+    // cgroups that directories share fate with (if configured)
+    struct eventfs_cgroup_table cgroups;
+    
     pthread_rwlock_t quota_lock;
+    pthread_mutex_t owner_lock;         // guards each user's list of directories
     eventfs_quota* user_quotas;
     eventfs_quota* group_quotas;
     
@@ -50,6 +104,23 @@ struct eventfs_state {
     char* mountpoint;
 };
 
+// identity of a caller that is not a FUSE request (e.g. journal replay)
+struct eventfs_caller {
+    
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
+};
+
+void eventfs_caller_set( struct eventfs_caller* caller );
+pid_t eventfs_caller_pid();
+uid_t eventfs_caller_uid( struct eventfs_state* eventfs );
+gid_t eventfs_caller_gid( struct eventfs_state* eventfs );
+
+int eventfs_dir_reap( struct eventfs_state* eventfs, char const* path );
+int eventfs_owner_remove_dir( struct eventfs_state* eventfs, struct eventfs_dir_inode* dir );
+int eventfs_owner_reclaim( struct eventfs_state* eventfs, struct fskit_entry* root, uid_t uid, struct eventfs_dir_inode* skip );
+
 int eventfs_quota_rlock( struct eventfs_state* eventfs );
 int eventfs_quota_wlock( struct eventfs_state* eventfs );
 int eventfs_quota_unlock( struct eventfs_state* eventfs );
@@ -0,0 +1,274 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "exitwatch.h"
+#include "eventfs.h"
+#include "proc.h"
+
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+#include <time.h>
+
+// convert a process event's timestamp to CLOCK_BOOTTIME.
+// the connector stamps events with CLOCK_MONOTONIC, which stops while the machine is suspended, but process
+// start times count from boot including suspend.  Events are read right after they are sent, so the current
+// difference between the two clocks is the one that applies.
+static uint64_t eventfs_exitwatch_boottime_ns( uint64_t monotonic_ns ) {
+   
+   struct timespec mono;
+   struct timespec boot;
+   
+   if( clock_gettime( CLOCK_MONOTONIC, &mono ) != 0 || clock_gettime( CLOCK_BOOTTIME, &boot ) != 0 ) {
+      return monotonic_ns;
+   }
+   
+   int64_t offset = ((int64_t)boot.tv_sec - (int64_t)mono.tv_sec) * 1000000000LL + ((int64_t)boot.tv_nsec - (int64_t)mono.tv_nsec);
+   if( offset < 0 ) {
+      offset = 0;
+   }
+   
+   return monotonic_ns + (uint64_t)offset;
+}
+
+
+// ask the kernel to start or stop sending us process events
+// return 0 on success
+// return -errno on failure to send
+static int eventfs_exitwatch_subscribe( int fd, enum proc_cn_mcast_op op ) {
+   
+   char buf[ NLMSG_SPACE( sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op) ) ] __attribute__((aligned(NLMSG_ALIGNTO)));
+   struct nlmsghdr* nlh = (struct nlmsghdr*)buf;
+   struct cn_msg* cn = NULL;
+   
+   memset( buf, 0, sizeof(buf) );
+   
+   nlh->nlmsg_len = NLMSG_LENGTH( sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op) );
+   nlh->nlmsg_type = NLMSG_DONE;
+   nlh->nlmsg_pid = getpid();
+   
+   cn = (struct cn_msg*)NLMSG_DATA( nlh );
+   cn->id.idx = CN_IDX_PROC;
+   cn->id.val = CN_VAL_PROC;
+   cn->len = sizeof(enum proc_cn_mcast_op);
+   memcpy( cn->data, &op, sizeof(enum proc_cn_mcast_op) );
+   
+   if( send( fd, buf, nlh->nlmsg_len, 0 ) < 0 ) {
+      return -errno;
+   }
+   
+   return 0;
+}
+
+
+// listener thread: mark exited creators as dead, and reap their directories right away.
+// events are dropped if we fall behind, so an overrun sweeps everything.
+static void* eventfs_exitwatch_main( void* arg ) {
+   
+   struct eventfs_exitwatch* ew = (struct eventfs_exitwatch*)arg;
+   char buf[ EVENTFS_EXITWATCH_BUF_LEN ] __attribute__((aligned(NLMSG_ALIGNTO)));
+   struct sockaddr_nl from;
+   socklen_t from_len = 0;
+   ssize_t len = 0;
+   int rc = 0;
+   
+   while( ew->running ) {
+      
+      bool reap = false;
+      
+      from_len = sizeof(struct sockaddr_nl);
+      len = recvfrom( ew->fd, buf, EVENTFS_EXITWATCH_BUF_LEN, 0, (struct sockaddr*)&from, &from_len );
+      if( len < 0 ) {
+         
+         rc = -errno;
+         if( rc == -EAGAIN || rc == -EWOULDBLOCK || rc == -EINTR ) {
+            
+            // timed out; check whether we're still running
+            continue;
+         }
+         
+         if( rc == -ENOBUFS ) {
+            
+            // lost events
+            eventfs_debug("%s", "process connector overrun; sweeping\n");
+            eventfs_deferred_reap( ew->eventfs );
+            continue;
+         }
+         
+         eventfs_error("recvfrom(process connector) rc = %d; falling back to sweeping\n", rc );
+         ew->running = false;
+         break;
+      }
+      
+      if( from.nl_pid != 0 ) {
+         
+         // not from the kernel
+         continue;
+      }
+      
+      for( struct nlmsghdr* nlh = (struct nlmsghdr*)buf; NLMSG_OK( nlh, len ); nlh = NLMSG_NEXT( nlh, len ) ) {
+         
+         if( nlh->nlmsg_type == NLMSG_NOOP ) {
+            continue;
+         }
+         
+         if( nlh->nlmsg_type == NLMSG_ERROR || nlh->nlmsg_type == NLMSG_OVERRUN ) {
+            
+            reap = true;
+            continue;
+         }
+         
+         struct cn_msg* cn = (struct cn_msg*)NLMSG_DATA( nlh );
+         if( cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC ) {
+            continue;
+         }
+         
+         struct proc_event* ev = (struct proc_event*)cn->data;
+         if( ev->what != PROC_EVENT_EXIT ) {
+            continue;
+         }
+         
+         // directories belong to the creating thread, so match on its thread ID
+         char** dir_paths = NULL;
+         
+         if( eventfs_proc_exited( ev->event_data.exit.process_pid, eventfs_exitwatch_boottime_ns( ev->timestamp_ns ), &dir_paths ) == 0 ) {
+            continue;
+         }
+         
+         eventfs_debug("creator %d exited\n", ev->event_data.exit.process_pid );
+         
+         if( dir_paths == NULL ) {
+            
+            // OOM; find them the slow way
+            reap = true;
+            continue;
+         }
+         
+         // reap just its directories
+         for( int i = 0; dir_paths[i] != NULL; i++ ) {
+            
+            rc = eventfs_dir_reap( ew->eventfs, dir_paths[i] );
+            if( rc != 0 ) {
+               
+               eventfs_error("eventfs_dir_reap('%s') rc = %d\n", dir_paths[i], rc );
+            }
+            
+            eventfs_safe_free( dir_paths[i] );
+         }
+         
+         eventfs_safe_free( dir_paths );
+      }
+      
+      if( reap ) {
+         
+         rc = eventfs_deferred_reap( ew->eventfs );
+         if( rc != 0 ) {
+            
+            eventfs_error("eventfs_deferred_reap rc = %d\n", rc );
+         }
+      }
+   }
+   
+   return NULL;
+}
+
+
+// start listening for process exits
+// return 0 on success
+// return -errno if the process connector is unavailable, or the thread could not be started.
+// in that case, nothing is running, and the caller should rely on sweeping alone.
+int eventfs_exitwatch_start( struct eventfs_exitwatch* ew, struct eventfs_state* eventfs ) {
+   
+   int rc = 0;
+   struct sockaddr_nl addr;
+   struct timeval tv;
+   
+   memset( ew, 0, sizeof(struct eventfs_exitwatch) );
+   ew->fd = -1;
+   ew->eventfs = eventfs;
+   
+   int fd = socket( PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR );
+   if( fd < 0 ) {
+      
+      rc = -errno;
+      return rc;
+   }
+   
+   memset( &addr, 0, sizeof(struct sockaddr_nl) );
+   addr.nl_family = AF_NETLINK;
+   addr.nl_groups = CN_IDX_PROC;
+   addr.nl_pid = 0;
+   
+   rc = bind( fd, (struct sockaddr*)&addr, sizeof(struct sockaddr_nl) );
+   if( rc != 0 ) {
+      
+      rc = -errno;
+      close( fd );
+      return rc;
+   }
+   
+   // wake up once a tick, so we can be stopped 
+   tv.tv_sec = EVENTFS_TIMER_TICK_MS / 1000;
+   tv.tv_usec = (EVENTFS_TIMER_TICK_MS % 1000) * 1000;
+   setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(struct timeval) );
+   
+   rc = eventfs_exitwatch_subscribe( fd, PROC_CN_MCAST_LISTEN );
+   if( rc != 0 ) {
+      
+      close( fd );
+      return rc;
+   }
+   
+   ew->fd = fd;
+   ew->running = true;
+   
+   rc = pthread_create( &ew->thread, NULL, eventfs_exitwatch_main, ew );
+   if( rc != 0 ) {
+      
+      ew->running = false;
+      ew->fd = -1;
+      
+      close( fd );
+      return -rc;
+   }
+   
+   return 0;
+}
+
+
+// stop listening for process exits, if we were 
+// always succeeds
+int eventfs_exitwatch_stop( struct eventfs_exitwatch* ew ) {
+   
+   if( ew->fd < 0 ) {
+      return 0;
+   }
+   
+   ew->running = false;
+   pthread_join( ew->thread, NULL );
+   
+   eventfs_exitwatch_subscribe( ew->fd, PROC_CN_MCAST_IGNORE );
+   close( ew->fd );
+   ew->fd = -1;
+   
+   return 0;
+}
@@ -0,0 +1,47 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _EVENTFS_EXITWATCH_H_
+#define _EVENTFS_EXITWATCH_H_
+
+#include "os.h"
+#include "util.h"
+
+// receive buffer for process connector messages
+#define EVENTFS_EXITWATCH_BUF_LEN       8192
+
+struct eventfs_state;
+
+// listener for process exit events from the kernel's process connector.
+// if the connector is unavailable (e.g. no CAP_NET_ADMIN), eventfs only finds dead creators by sweeping.
+struct eventfs_exitwatch {
+   
+   int fd;                              // NETLINK_CONNECTOR socket (-1 if not listening)
+   pthread_t thread;
+   volatile bool running;
+   
+   struct eventfs_state* eventfs;
+};
+
+int eventfs_exitwatch_start( struct eventfs_exitwatch* ew, struct eventfs_state* eventfs );
+int eventfs_exitwatch_stop( struct eventfs_exitwatch* ew );
+
+#endif
@@ -20,6 +20,100 @@
 */
 #include "inode.h"
 #include "deferred.h"
+#include "ttl.h"
+#include "lease.h"
+#include "journal.h"
+#include "eventfs.h"
+
+#include <stdatomic.h>
+
+// next unclaimed batch of eventfs inode numbers 
+static atomic_uint_fast64_t g_inode_number_next_batch = 0;
+
+// this thread's current batch 
+static _Thread_local uint64_t g_inode_number_next = 0;
+static _Thread_local uint64_t g_inode_number_end = 0;
+
+// a batch of inode numbers whose entries have been destroyed
+struct eventfs_inode_number_pool {
+   
+   struct eventfs_inode_number_pool* next;
+   int count;
+   uint64_t numbers[EVENTFS_INODE_NUMBER_BATCH];
+};
+
+// inode numbers this thread has given back, and will hand out again first
+static _Thread_local struct eventfs_inode_number_pool* g_inode_number_free = NULL;
+
+// full pools given back by threads that destroy more entries than they create
+static pthread_mutex_t g_inode_number_recycled_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct eventfs_inode_number_pool* g_inode_number_recycled = NULL;
+
+// next directory generation (0 means "no directory")
+static atomic_uint_fast64_t g_dir_generation_next = 1;
+
+// make a directory's .push queue, with the directory's reference
+// return the queue on success 
+// return NULL on OOM
+static struct eventfs_push_queue* eventfs_push_queue_new( void ) {
+   
+   struct eventfs_push_queue* queue = EVENTFS_CALLOC( struct eventfs_push_queue, 1 );
+   if( queue == NULL ) {
+      return NULL;
+   }
+   
+   if( pthread_mutex_init( &queue->lock, NULL ) != 0 ) {
+      
+      eventfs_safe_free( queue );
+      return NULL;
+   }
+   
+   if( pthread_cond_init( &queue->cond, NULL ) != 0 ) {
+      
+      pthread_mutex_destroy( &queue->lock );
+      eventfs_safe_free( queue );
+      return NULL;
+   }
+   
+   queue->pending_tail = &queue->pending;
+   queue->refs = 1;
+   return queue;
+}
+
+
+// take a reference to a directory's .push queue, so it can be waited on without holding the directory
+// return the queue
+// NOTE: the directory that owns it must be locked
+struct eventfs_push_queue* eventfs_push_queue_ref( struct eventfs_push_queue* queue ) {
+   
+   pthread_mutex_lock( &queue->lock );
+   queue->refs++;
+   pthread_mutex_unlock( &queue->lock );
+   
+   return queue;
+}
+
+
+// let go of a reference to a .push queue, and free it if it was the last one
+// return 0 on success
+int eventfs_push_queue_unref( struct eventfs_push_queue* queue ) {
+   
+   int refs = 0;
+   
+   pthread_mutex_lock( &queue->lock );
+   refs = --queue->refs;
+   pthread_mutex_unlock( &queue->lock );
+   
+   if( refs == 0 ) {
+      
+      pthread_mutex_destroy( &queue->lock );
+      pthread_cond_destroy( &queue->cond );
+      eventfs_safe_free( queue );
+   }
+   
+   return 0;
+}
+
 
 // set up a pidfile inode 
 // return 0 on success
@@ -28,23 +122,24 @@
 int eventfs_dir_inode_init( struct eventfs_dir_inode* inode, pid_t pid, int verify_discipline ) {
    
    int rc = 0;
-   int flags = 0;
    
    memset( inode, 0, sizeof(struct eventfs_dir_inode) );
    
-   inode->ps = pstat_new();
-   if( inode->ps == NULL ) {
-      return -ENOMEM;
+   inode->proc = eventfs_proc_get( pid, &rc );
+   if( inode->proc == NULL ) {
+      return rc;
    }
    
-   rc = pstat( pid, inode->ps, flags );
-   if( rc != 0 ) {
-       
-      pstat_free( inode->ps );
-      return rc;
+   inode->push_queue = eventfs_push_queue_new();
+   if( inode->push_queue == NULL ) {
+      
+      eventfs_proc_put( inode->proc );
+      inode->proc = NULL;
+      return -ENOMEM;
    }
    
    inode->verify_discipline = verify_discipline;
+   inode->generation = atomic_fetch_add( &g_dir_generation_next, 1 );
    
    inode->fent_head = NULL;
    inode->fent_tail = NULL;
@@ -59,16 +154,17 @@ int eventfs_dir_inode_init( struct eventfs_dir_inode* inode, pid_t pid, int veri
 // return negative on error
 static int eventfs_dir_inode_is_created_by_proc( struct eventfs_dir_inode* inode, struct pstat* proc_stat, int verify_discipline ) {
    
+   struct pstat* inode_ps = eventfs_proc_get_pstat( inode->proc );
    struct stat sb;
    struct stat inode_sb;
    char bin_path[PATH_MAX+1];
    char inode_path[PATH_MAX+1];
    
    pstat_get_stat( proc_stat, &sb );
-   pstat_get_stat( inode->ps, &inode_sb );
+   pstat_get_stat( inode_ps, &inode_sb );
    
    pstat_get_path( proc_stat, bin_path );
-   pstat_get_path( inode->ps, inode_path );
+   pstat_get_path( inode_ps, inode_path );
    
    if( !pstat_is_running( proc_stat ) ) {
    
@@ -76,9 +172,9 @@ static int eventfs_dir_inode_is_created_by_proc( struct eventfs_dir_inode* inode
       return 0;
    }
    
-   if( pstat_get_pid( proc_stat ) != pstat_get_pid( inode->ps ) ) {
+   if( pstat_get_pid( proc_stat ) != pstat_get_pid( inode_ps ) ) {
       
-      eventfs_debug("PID mismatch: %d != %d\n", pstat_get_pid( inode->ps ), pstat_get_pid( proc_stat ) );
+      eventfs_debug("PID mismatch: %d != %d\n", pstat_get_pid( inode_ps ), pstat_get_pid( proc_stat ) );
       return 0;
    }
    
@@ -86,7 +182,7 @@ static int eventfs_dir_inode_is_created_by_proc( struct eventfs_dir_inode* inode
       
       if( pstat_is_deleted( proc_stat ) || inode_sb.st_ino != sb.st_ino ) {
          
-         eventfs_debug("%d: Inode mismatch: %ld != %ld\n", pstat_get_pid( inode->ps ), inode_sb.st_ino, sb.st_ino );
+         eventfs_debug("%d: Inode mismatch: %ld != %ld\n", pstat_get_pid( inode_ps ), inode_sb.st_ino, sb.st_ino );
          return 0;
       }
    }
@@ -94,7 +190,7 @@ static int eventfs_dir_inode_is_created_by_proc( struct eventfs_dir_inode* inode
    if( verify_discipline & EVENTFS_VERIFY_SIZE ) {
       if( pstat_is_deleted( proc_stat ) || inode_sb.st_size != sb.st_size ) {
          
-         eventfs_debug("%d: Size mismatch: %jd != %jd\n", pstat_get_pid( inode->ps ), inode_sb.st_size, sb.st_size );
+         eventfs_debug("%d: Size mismatch: %jd != %jd\n", pstat_get_pid( inode_ps ), inode_sb.st_size, sb.st_size );
          return 0;
       }
    }
@@ -102,7 +198,7 @@ static int eventfs_dir_inode_is_created_by_proc( struct eventfs_dir_inode* inode
    if( verify_discipline & EVENTFS_VERIFY_MTIME ) {
       if( pstat_is_deleted( proc_stat )|| inode_sb.st_mtim.tv_sec != sb.st_mtim.tv_sec || inode_sb.st_mtim.tv_nsec != sb.st_mtim.tv_nsec ) {
          
-         eventfs_debug("%d: Modtime mismatch: %ld.%ld != %ld.%ld\n", pstat_get_pid( inode->ps ), inode_sb.st_mtim.tv_sec, inode_sb.st_mtim.tv_nsec, sb.st_mtim.tv_sec, sb.st_mtim.tv_nsec );
+         eventfs_debug("%d: Modtime mismatch: %ld.%ld != %ld.%ld\n", pstat_get_pid( inode_ps ), inode_sb.st_mtim.tv_sec, inode_sb.st_mtim.tv_nsec, sb.st_mtim.tv_sec, sb.st_mtim.tv_nsec );
          return 0;
       }
    }
@@ -111,16 +207,16 @@ static int eventfs_dir_inode_is_created_by_proc( struct eventfs_dir_inode* inode
        
       if( pstat_is_deleted( proc_stat ) || strcmp(bin_path, inode_path) != 0 ) {
          
-         eventfs_debug("%d: Path mismatch: %s != %s\n", pstat_get_pid( inode->ps ), inode_path, bin_path );
+         eventfs_debug("%d: Path mismatch: %s != %s\n", pstat_get_pid( inode_ps ), inode_path, bin_path );
          return 0;
       }
    }
    
    if( verify_discipline & EVENTFS_VERIFY_STARTTIME ) {
       
-      if( pstat_get_starttime( proc_stat ) != pstat_get_starttime( inode->ps ) ) {
+      if( pstat_get_starttime( proc_stat ) != pstat_get_starttime( inode_ps ) ) {
           
-         eventfs_debug("%d: Start time mismatch: %" PRIu64 " != %" PRIu64 "\n", pstat_get_pid( inode->ps ), pstat_get_starttime( proc_stat ), pstat_get_starttime( inode->ps ) );
+         eventfs_debug("%d: Start time mismatch: %" PRIu64 " != %" PRIu64 "\n", pstat_get_pid( inode_ps ), pstat_get_starttime( proc_stat ), pstat_get_starttime( inode_ps ) );
          return 0;
       }
    }
@@ -131,30 +227,58 @@ static int eventfs_dir_inode_is_created_by_proc( struct eventfs_dir_inode* inode
 
 // verify that a directory inode is still valid.
 // that is, there's a process with the given PID running, and it's an instance of the same program that created it.
-// to speed this up, only check the hash of the process binary if the modtime has changed
+// to speed this up, only check the hash of the process binary if the modtime has changed.
+// with EVENTFS_VERIFY_FAST, only check that the process with that PID has the same start time.
+// a directory bound to a cgroup is valid for as long as the cgroup has processes in it.
+// a directory in lease mode is valid for as long as its lease is, and we don't look at /proc at all.
 // return 1 if valid 
 // return 0 if not valid 
 // return negative on error
-int eventfs_dir_inode_is_valid( struct eventfs_dir_inode* inode ) {
+int eventfs_dir_inode_is_valid( struct eventfs_dir_inode* inode, int verify_discipline ) {
    
    int rc = 0;
-   struct pstat* ps = pstat_new();
-   if( ps == NULL ) {
-      return -ENOMEM;
+   struct pstat* ps = NULL;
+   pid_t pid = pstat_get_pid( eventfs_proc_get_pstat( inode->proc ) );
+   
+   if( inode->lease != NULL ) {
+      
+      // lives as long as its owner keeps renewing its lease 
+      return (eventfs_lease_is_live( inode ) ? 1 : 0);
    }
    
-   pid_t pid = pstat_get_pid( inode->ps );
+   if( inode->cgroup != NULL ) {
+      
+      // shares fate with its cgroup, not its creator 
+      return (eventfs_cgroup_is_populated( inode->cgroup ) ? 1 : 0);
+   }
    
-   rc = pstat( pid, ps, 0 );
+   if( eventfs_proc_has_exited( inode->proc ) ) {
+      
+      // no need to look
+      return 0;
+   }
+   
+   if( verify_discipline & EVENTFS_VERIFY_FAST ) {
+      
+      // only check that the same process is still running 
+      rc = eventfs_proc_is_alive( inode->proc );
+      if( rc < 0 ) {
+         
+         eventfs_error("eventfs_proc_is_alive(%d) rc = %d\n", pid, rc );
+      }
+      
+      return rc;
+   }
+   
+   rc = eventfs_proc_lock_current( inode->proc, &ps );
    if( rc < 0 ) {
        
-      pstat_free( ps );
       eventfs_error("pstat(%d) rc = %d\n", pid, rc );
       return rc;
    }
    
-   rc = eventfs_dir_inode_is_created_by_proc( inode, ps, inode->verify_discipline );
-   pstat_free( ps );
+   rc = eventfs_dir_inode_is_created_by_proc( inode, ps, verify_discipline );
+   eventfs_proc_unlock( inode->proc );
    
    if( rc < 0 ) {
        
@@ -165,14 +289,81 @@ int eventfs_dir_inode_is_valid( struct eventfs_dir_inode* inode ) {
    return rc;
 }
 
+// free a symlink's retired targets.
+// NOTE: the symlink must be write-locked or destroyed, so no readlink can still be copying one
+static void eventfs_dir_inode_retired_free( struct eventfs_retired_targets* retired ) {
+   
+   for( int i = 0; i < retired->count; i++ ) {
+      
+      eventfs_safe_free( retired->targets[i] );
+   }
+   
+   retired->count = 0;
+}
+
+
 // free a directory inode.
 // must be empty (otherwise returns -ENOTEMPTY)
 int eventfs_dir_inode_free( struct fskit_core* core, struct eventfs_dir_inode* inode ) {
    
-   if( inode->ps != NULL ) {
+   struct eventfs_state* eventfs = (struct eventfs_state*)fskit_core_get_user_data( core );
+   
+   // first, so a user reclaiming dead directories can't find it while it's going away
+   eventfs_owner_remove_dir( eventfs, inode );
+   
+   eventfs_ttl_release( eventfs, inode );
+   eventfs_lease_release( eventfs, inode );
+   
+   if( inode->cgroup != NULL ) {
       
-      pstat_free( inode->ps );
-      inode->ps = NULL;
+      eventfs_cgroup_remove_dir( &eventfs->cgroups, inode->cgroup, inode );
+      eventfs_cgroup_put( &eventfs->cgroups, inode->cgroup );
+      inode->cgroup = NULL;
+   }
+   
+   if( inode->proc != NULL ) {
+      
+      eventfs_proc_remove_dir( inode->proc, inode );
+      eventfs_proc_put( inode->proc );
+      inode->proc = NULL;
+   }
+   
+   eventfs_safe_free( inode->path );
+   
+   // cursors belong to their files; just forget them
+   for( struct eventfs_cursor* itr = inode->cursors; itr != NULL; ) {
+      
+      struct eventfs_cursor* old_itr = itr;
+      itr = itr->next;
+      
+      old_itr->pos = NULL;
+      old_itr->next = NULL;
+   }
+   
+   // producers still waiting on it hold their own references
+   if( inode->push_queue != NULL ) {
+      
+      eventfs_push_queue_unref( inode->push_queue );
+      inode->push_queue = NULL;
+   }
+   
+   // the symlinks are gone, and so are their readers
+   eventfs_dir_inode_retired_free( &inode->retired_head );
+   eventfs_dir_inode_retired_free( &inode->retired_tail );
+   
+   // symlinks kept from the last time it had files 
+   if( inode->spare_head != NULL ) {
+       
+       eventfs_inode_number_release( fskit_entry_get_file_id( inode->spare_head ) );
+       fskit_entry_destroy( core, inode->spare_head, false );
+       eventfs_safe_free( inode->spare_head );
+   }
+   
+   if( inode->spare_tail != NULL ) {
+       
+       eventfs_inode_number_release( fskit_entry_get_file_id( inode->spare_tail ) );
+       fskit_entry_destroy( core, inode->spare_tail, false );
+       eventfs_safe_free( inode->spare_tail );
    }
    
    if( inode->head != NULL ) {
@@ -182,7 +373,6 @@ int eventfs_dir_inode_free( struct fskit_core* core, struct eventfs_dir_inode* i
            struct eventfs_file_deque* old_itr = itr;
            itr = itr->next;
            
-           eventfs_safe_free( old_itr->name );
            eventfs_safe_free( old_itr );
        }
    }
@@ -192,6 +382,90 @@ int eventfs_dir_inode_free( struct fskit_core* core, struct eventfs_dir_inode* i
 }
 
 
+// get an inode number for an entry that eventfs creates itself (.push messages, head and tail symlinks).
+// numbers this thread gave back come first, then the rest of this thread's fresh batch, then a pool
+// of numbers another thread gave back, and only then a fresh batch from the shared atomic counter.
+// only the last two steps touch shared state, once per EVENTFS_INODE_NUMBER_BATCH numbers.
+uint64_t eventfs_inode_number_alloc( void ) {
+   
+   struct eventfs_inode_number_pool* pool = NULL;
+   
+   if( g_inode_number_free != NULL && g_inode_number_free->count > 0 ) {
+      
+      g_inode_number_free->count--;
+      return g_inode_number_free->numbers[ g_inode_number_free->count ];
+   }
+   
+   if( g_inode_number_next == g_inode_number_end ) {
+      
+      pthread_mutex_lock( &g_inode_number_recycled_lock );
+      
+      pool = g_inode_number_recycled;
+      if( pool != NULL ) {
+         g_inode_number_recycled = pool->next;
+      }
+      
+      pthread_mutex_unlock( &g_inode_number_recycled_lock );
+      
+      if( pool != NULL ) {
+         
+         // replaces our (empty) pool
+         eventfs_safe_free( g_inode_number_free );
+         g_inode_number_free = pool;
+         
+         pool->count--;
+         return pool->numbers[ pool->count ];
+      }
+      
+      // recycling keeps the count of claimed batches down to the peak number of live entries,
+      // so this only wraps if that ever exceeds the space.
+      uint64_t batch = atomic_fetch_add( &g_inode_number_next_batch, 1 );
+      
+      g_inode_number_next = EVENTFS_INODE_NUMBER_BASE + (batch * EVENTFS_INODE_NUMBER_BATCH) % EVENTFS_INODE_NUMBER_SPACE;
+      g_inode_number_end = g_inode_number_next + EVENTFS_INODE_NUMBER_BATCH;
+   }
+   
+   return g_inode_number_next++;
+}
+
+
+// give back the inode number of an entry that has been destroyed, so it can be handed out again.
+// nothing can reach the old entry by then (it has no path and no open handles), so reuse is never seen as stale.
+// numbers that fskit allocated are ignored.
+void eventfs_inode_number_release( uint64_t inode_number ) {
+   
+   if( inode_number < EVENTFS_INODE_NUMBER_BASE || inode_number >= EVENTFS_INODE_NUMBER_BASE + EVENTFS_INODE_NUMBER_SPACE ) {
+      return;
+   }
+   
+   if( g_inode_number_free == NULL ) {
+      
+      g_inode_number_free = EVENTFS_CALLOC( struct eventfs_inode_number_pool, 1 );
+      if( g_inode_number_free == NULL ) {
+         
+         // lose it
+         return;
+      }
+   }
+   
+   g_inode_number_free->numbers[ g_inode_number_free->count ] = inode_number;
+   g_inode_number_free->count++;
+   
+   if( g_inode_number_free->count == EVENTFS_INODE_NUMBER_BATCH ) {
+      
+      // full; let a thread that creates entries have it
+      pthread_mutex_lock( &g_inode_number_recycled_lock );
+      
+      g_inode_number_free->next = g_inode_number_recycled;
+      g_inode_number_recycled = g_inode_number_free;
+      
+      pthread_mutex_unlock( &g_inode_number_recycled_lock );
+      
+      g_inode_number_free = NULL;
+   }
+}
+
+
 // set up a file inode 
 int eventfs_file_inode_init( struct eventfs_file_inode* inode ) {
     
@@ -203,8 +477,18 @@ int eventfs_file_inode_init( struct eventfs_file_inode* inode ) {
 // must be removed from its parent directory already 
 int eventfs_file_inode_free( struct eventfs_file_inode* inode ) {
     
-   if( inode->contents != NULL ) {
-       eventfs_safe_free( inode->contents );
+   if( inode->chunks != NULL ) {
+       
+       for( uint64_t i = 0; i < inode->num_chunks; i++ ) {
+           eventfs_safe_free( inode->chunks[i] );
+       }
+       
+       eventfs_safe_free( inode->chunks );
+   }
+   
+   if( inode->cursor != NULL ) {
+       eventfs_cursor_free( inode->cursor );
+       eventfs_safe_free( inode->cursor );
    }
    
    memset( inode, 0, sizeof(struct eventfs_file_inode) );
@@ -212,6 +496,403 @@ int eventfs_file_inode_free( struct eventfs_file_inode* inode ) {
 }
 
 
+// get the chunk that holds bytes [start, end) of a file inode's chunk i, allocating it if need be.
+// the first chunk grows by doubling up to EVENTFS_CHUNK_SIZE, so small messages stay small;
+// every other chunk is allocated whole.  New space reads as zeros.
+// return the chunk on success 
+// return NULL on OOM
+static char* eventfs_file_inode_chunk( struct eventfs_file_inode* inode, uint64_t i, size_t end ) {
+   
+   uint64_t new_num_chunks = inode->num_chunks;
+   size_t new_head_len = inode->head_len;
+   
+   // expand the chunk table?
+   if( i >= inode->num_chunks ) {
+      
+      if( new_num_chunks == 0 ) {
+         new_num_chunks = 1;
+      }
+      
+      while( i >= new_num_chunks ) {
+         new_num_chunks *= 2;
+      }
+      
+      char** tmp = (char**)realloc( inode->chunks, new_num_chunks * sizeof(char*) );
+      if( tmp == NULL ) {
+         return NULL;
+      }
+      
+      memset( tmp + inode->num_chunks, 0, (new_num_chunks - inode->num_chunks) * sizeof(char*) );
+      
+      inode->chunks = tmp;
+      inode->num_chunks = new_num_chunks;
+   }
+   
+   if( i > 0 ) {
+      
+      if( inode->chunks[i] == NULL ) {
+         
+         inode->chunks[i] = EVENTFS_CALLOC( char, EVENTFS_CHUNK_SIZE );
+      }
+      
+      return inode->chunks[i];
+   }
+   
+   // expand the first chunk?
+   if( new_head_len == 0 ) {
+      new_head_len = 1;
+   }
+   
+   while( end > new_head_len ) {
+      new_head_len *= 2;
+   }
+   
+   if( new_head_len > EVENTFS_CHUNK_SIZE ) {
+      new_head_len = EVENTFS_CHUNK_SIZE;
+   }
+   
+   if( new_head_len > inode->head_len ) {
+      
+      char* tmp = (char*)realloc( inode->chunks[0], new_head_len );
+      if( tmp == NULL ) {
+         return NULL;
+      }
+      
+      memset( tmp + inode->head_len, 0, new_head_len - inode->head_len );
+      
+      inode->chunks[0] = tmp;
+      inode->head_len = new_head_len;
+   }
+   
+   return inode->chunks[0];
+}
+
+
+// move a file inode's inline contents into its first chunk, once they outgrow the inode 
+// return 0 on success 
+// return -ENOMEM on OOM
+static int eventfs_file_inode_uninline( struct eventfs_file_inode* inode ) {
+   
+   size_t len = (inode->size < EVENTFS_INLINE_SIZE ? inode->size : EVENTFS_INLINE_SIZE);
+   
+   char* chunk = eventfs_file_inode_chunk( inode, 0, len );
+   if( chunk == NULL ) {
+      return -ENOMEM;
+   }
+   
+   memcpy( chunk, inode->inline_contents, len );
+   memset( inode->inline_contents, 0, EVENTFS_INLINE_SIZE );
+   return 0;
+}
+
+
+// read from a file inode's contents.  Holes read as zeros.
+// return the number of bytes read on success
+// return 0 on EOF
+ssize_t eventfs_file_inode_read( struct eventfs_file_inode* inode, char* buf, size_t buflen, off_t offset ) {
+   
+   size_t num_read = 0;
+   
+   if( offset >= inode->size ) {
+      return 0;
+   }
+   
+   if( (uint64_t)(inode->size - offset) < buflen ) {
+      buflen = inode->size - offset;
+   }
+   
+   if( inode->chunks == NULL ) {
+      
+      // inline (anything past the inline buffer is a hole)
+      if( offset < EVENTFS_INLINE_SIZE ) {
+         
+         num_read = EVENTFS_INLINE_SIZE - offset;
+         if( num_read > buflen ) {
+            num_read = buflen;
+         }
+         
+         memcpy( buf, inode->inline_contents + offset, num_read );
+      }
+      
+      memset( buf + num_read, 0, buflen - num_read );
+      return buflen;
+   }
+   
+   while( num_read < buflen ) {
+      
+      uint64_t pos = offset + num_read;
+      uint64_t i = pos / EVENTFS_CHUNK_SIZE;
+      size_t chunk_off = pos % EVENTFS_CHUNK_SIZE;
+      size_t len = EVENTFS_CHUNK_SIZE - chunk_off;
+      
+      if( len > buflen - num_read ) {
+         len = buflen - num_read;
+      }
+      
+      char const* chunk = (i < inode->num_chunks ? inode->chunks[i] : NULL);
+      
+      if( chunk != NULL && (i > 0 || chunk_off < inode->head_len) ) {
+         
+         size_t avail = len;
+         
+         if( i == 0 && chunk_off + len > inode->head_len ) {
+            
+            // rest of the first chunk was never written 
+            avail = inode->head_len - chunk_off;
+         }
+         
+         memcpy( buf + num_read, chunk + chunk_off, avail );
+         memset( buf + num_read + avail, 0, len - avail );
+      }
+      else {
+         
+         memset( buf + num_read, 0, len );
+      }
+      
+      num_read += len;
+   }
+   
+   return num_read;
+}
+
+
+// write to a file inode's contents, expanding them if we write off the edge.
+// only the chunks written to are touched, so appending costs as much as the write.
+// return the number of bytes written on success
+// return -ENOMEM on OOM
+ssize_t eventfs_file_inode_write( struct eventfs_file_inode* inode, char const* buf, size_t buflen, off_t offset ) {
+   
+   size_t num_written = 0;
+   int rc = 0;
+   
+   if( inode->chunks == NULL ) {
+      
+      if( (uint64_t)offset + buflen <= EVENTFS_INLINE_SIZE ) {
+         
+         // still fits inline
+         memcpy( inode->inline_contents + offset, buf, buflen );
+         
+         if( (uint64_t)offset + buflen > (uint64_t)inode->size ) {
+            inode->size = offset + buflen;
+         }
+         
+         return buflen;
+      }
+      
+      rc = eventfs_file_inode_uninline( inode );
+      if( rc != 0 ) {
+         return rc;
+      }
+   }
+   
+   while( num_written < buflen ) {
+      
+      uint64_t pos = offset + num_written;
+      uint64_t i = pos / EVENTFS_CHUNK_SIZE;
+      size_t chunk_off = pos % EVENTFS_CHUNK_SIZE;
+      size_t len = EVENTFS_CHUNK_SIZE - chunk_off;
+      
+      if( len > buflen - num_written ) {
+         len = buflen - num_written;
+      }
+      
+      char* chunk = eventfs_file_inode_chunk( inode, i, chunk_off + len );
+      if( chunk == NULL ) {
+         return -ENOMEM;
+      }
+      
+      memcpy( chunk + chunk_off, buf + num_written, len );
+      num_written += len;
+   }
+   
+   // expand size?
+   if( (uint64_t)offset + buflen > (uint64_t)inode->size ) {
+      inode->size = offset + buflen;
+   }
+   
+   return buflen;
+}
+
+
+// truncate a file inode's contents.
+// growing it leaves a hole; shrinking it frees the chunks past the end, and zeros the rest of the last one.
+// return 0 on success
+// always succeeds
+int eventfs_file_inode_truncate( struct eventfs_file_inode* inode, off_t new_size ) {
+   
+   if( new_size < inode->size && inode->chunks == NULL ) {
+      
+      if( new_size < EVENTFS_INLINE_SIZE ) {
+         memset( inode->inline_contents + new_size, 0, EVENTFS_INLINE_SIZE - new_size );
+      }
+   }
+   else if( new_size < inode->size ) {
+      
+      uint64_t last = new_size / EVENTFS_CHUNK_SIZE;
+      size_t chunk_off = new_size % EVENTFS_CHUNK_SIZE;
+      
+      for( uint64_t i = last + 1; i < inode->num_chunks; i++ ) {
+         eventfs_safe_free( inode->chunks[i] );
+      }
+      
+      if( last < inode->num_chunks && inode->chunks[last] != NULL && chunk_off == 0 ) {
+         
+         // truncated to a chunk boundary, so nothing is left in this one
+         eventfs_safe_free( inode->chunks[last] );
+         
+         if( last == 0 ) {
+            inode->head_len = 0;
+         }
+      }
+      else if( last < inode->num_chunks && inode->chunks[last] != NULL ) {
+         
+         size_t chunk_len = (last > 0 ? EVENTFS_CHUNK_SIZE : inode->head_len);
+         
+         if( chunk_off < chunk_len ) {
+            memset( inode->chunks[last] + chunk_off, 0, chunk_len - chunk_off );
+         }
+      }
+   }
+   
+   // new size 
+   inode->size = new_size;
+   return 0;
+}
+
+
+// make a cursor for the given cursor file.
+// it starts out caught up; add it to a directory to point it at the directory's head.
+// return the cursor on success
+// return NULL on OOM
+struct eventfs_cursor* eventfs_cursor_new( struct fskit_entry* fent ) {
+   
+   int rc = 0;
+   struct eventfs_cursor* cursor = EVENTFS_CALLOC( struct eventfs_cursor, 1 );
+   if( cursor == NULL ) {
+      return NULL;
+   }
+   
+   rc = pthread_mutex_init( &cursor->lock, NULL );
+   if( rc != 0 ) {
+      
+      eventfs_safe_free( cursor );
+      return NULL;
+   }
+   
+   cursor->fent = fent;
+   return cursor;
+}
+
+
+// free a cursor's state 
+// NOTE: it must not be in a directory anymore
+int eventfs_cursor_free( struct eventfs_cursor* cursor ) {
+   
+   eventfs_safe_free( cursor->target );
+   pthread_mutex_destroy( &cursor->lock );
+   
+   memset( cursor, 0, sizeof(struct eventfs_cursor) );
+   return 0;
+}
+
+
+// read a cursor file: the name of the next unread file, and a newline.
+// return the number of bytes read on success 
+// return 0 on EOF, or if the cursor is caught up
+int eventfs_cursor_read( struct eventfs_cursor* cursor, char* buf, size_t buflen, off_t offset ) {
+   
+   int num_read = 0;
+   off_t size = 0;
+   
+   pthread_mutex_lock( &cursor->lock );
+   
+   if( cursor->target != NULL ) {
+      size = strlen( cursor->target );
+   }
+   
+   if( offset < size ) {
+      
+      num_read = ((off_t)buflen < size - offset ? (int)buflen : (int)(size - offset));
+      memcpy( buf, cursor->target + offset, num_read );
+   }
+   
+   pthread_mutex_unlock( &cursor->lock );
+   
+   return num_read;
+}
+
+
+// make a handle that publishes a message (or moves a cursor) on close.
+// a .push or cursor handle gets an empty buffer to stage writes in.
+// return the handle on success
+// return NULL on OOM
+struct eventfs_file_handle* eventfs_file_handle_new( int type, uid_t owner, gid_t group ) {
+   
+   struct eventfs_file_handle* handle = EVENTFS_CALLOC( struct eventfs_file_handle, 1 );
+   if( handle == NULL ) {
+      return NULL;
+   }
+   
+   if( type == EVENTFS_HANDLE_PUSH || type == EVENTFS_HANDLE_CURSOR ) {
+      
+      handle->staged = EVENTFS_CALLOC( struct eventfs_file_inode, 1 );
+      if( handle->staged == NULL ) {
+         
+         eventfs_safe_free( handle );
+         return NULL;
+      }
+      
+      eventfs_file_inode_init( handle->staged );
+   }
+   
+   handle->type = type;
+   handle->owner = owner;
+   handle->group = group;
+   return handle;
+}
+
+
+// free a file handle, and its staged message if it was not published
+int eventfs_file_handle_free( struct eventfs_file_handle* handle ) {
+   
+   if( handle->staged != NULL ) {
+      
+      eventfs_file_inode_free( handle->staged );
+      eventfs_safe_free( handle->staged );
+   }
+   
+   memset( handle, 0, sizeof(struct eventfs_file_handle) );
+   return 0;
+}
+
+
+// point a head or tail symlink at a new target, without waiting for readers of the old one.
+// fskit's readlink copies the target out under the symlink's read lock, so the old target is retired instead of freed.
+// once EVENTFS_RETIRE_BATCH of them pile up, taking the write lock once waits out every reader that could
+// have seen any of them (later readers see the new target), and then they are all freed.
+// NOTE: symlink must not be locked; takes ownership of target
+// NOTE: the directory must be write-locked
+static void eventfs_dir_inode_swap_target( struct fskit_entry* symlink, struct eventfs_retired_targets* retired, char* target ) {
+   
+   char* old_target = fskit_entry_swap_symlink_target( symlink, target );
+   if( old_target == NULL ) {
+      return;
+   }
+   
+   if( retired->count == EVENTFS_RETIRE_BATCH ) {
+      
+      // drain readers 
+      fskit_entry_wlock( symlink );
+      fskit_entry_unlock( symlink );
+      
+      eventfs_dir_inode_retired_free( retired );
+   }
+   
+   retired->targets[ retired->count ] = old_target;
+   retired->count++;
+}
+
+
 // update the deque head link when it itself gets unlinked.
 // re-attach it to the parent inode, and retarget it to the next-oldest file.
 // return 0 on success
@@ -226,10 +907,13 @@ static int eventfs_dir_head_symlink_restore( struct fskit_core* core, struct eve
     
     if( dir->fent_head != NULL ) {
         
+        fskit_entry_wlock( dir->fent_head );
+        
+        // no readers left, since we have it write-locked
         char* old_symlink = fskit_entry_swap_symlink_target( dir->fent_head, name_dup );
         eventfs_safe_free( old_symlink );
+        eventfs_dir_inode_retired_free( &dir->retired_head );
         
-        fskit_entry_wlock( dir->fent_head );
         fskit_entry_attach_lowlevel( dent, dir->fent_head, "head" );
         fskit_entry_unlock( dir->fent_head );
     }
@@ -251,10 +935,13 @@ static int eventfs_dir_tail_symlink_restore( struct fskit_core* core, struct eve
     
     if( dir->fent_tail != NULL ) {
         
+        fskit_entry_wlock( dir->fent_tail );
+        
+        // no readers left, since we have it write-locked
         char* old_symlink = fskit_entry_swap_symlink_target( dir->fent_tail, name_dup );
         eventfs_safe_free( old_symlink );
+        eventfs_dir_inode_retired_free( &dir->retired_tail );
         
-        fskit_entry_wlock( dir->fent_tail );
         fskit_entry_attach_lowlevel( dent, dir->fent_tail, "tail" );
         fskit_entry_unlock( dir->fent_tail );
     }
@@ -263,6 +950,79 @@ static int eventfs_dir_tail_symlink_restore( struct fskit_core* core, struct eve
 }
 
 
+// point a cursor at the next file it has not read (NULL if it has read them all), and keep its file's size in sync.
+// the cursor always moves, even if we run out of memory for its file's contents.
+// return 0 on success 
+// return -ENOMEM on OOM
+// NOTE: the cursor's directory must be write-locked
+static int eventfs_cursor_retarget( struct eventfs_cursor* cursor, struct eventfs_file_deque* pos ) {
+   
+   int rc = 0;
+   char* target = NULL;
+   char* old_target = NULL;
+   off_t size = 0;
+   
+   if( pos != NULL ) {
+      
+      target = EVENTFS_CALLOC( char, strlen(pos->name) + 2 );
+      if( target == NULL ) {
+         
+         rc = -ENOMEM;
+      }
+      else {
+         
+         sprintf( target, "%s\n", pos->name );
+         size = strlen( target );
+      }
+   }
+   
+   pthread_mutex_lock( &cursor->lock );
+   
+   old_target = cursor->target;
+   cursor->target = target;
+   cursor->pos = pos;
+   
+   pthread_mutex_unlock( &cursor->lock );
+   
+   eventfs_safe_free( old_target );
+   
+   if( cursor->fent != NULL ) {
+      
+      fskit_entry_wlock( cursor->fent );
+      fskit_entry_set_size( cursor->fent, size );
+      fskit_entry_unlock( cursor->fent );
+   }
+   
+   return rc;
+}
+
+
+// move every cursor that is on a file that is about to leave the deque to the file after it
+// NOTE: dir must be write-locked
+static void eventfs_dir_inode_cursors_skip( struct eventfs_dir_inode* dir, struct eventfs_file_deque* ptr ) {
+   
+   for( struct eventfs_cursor* itr = dir->cursors; itr != NULL; itr = itr->next ) {
+      
+      if( itr->pos == ptr ) {
+         eventfs_cursor_retarget( itr, ptr->next );
+      }
+   }
+}
+
+
+// point every caught-up cursor at a newly-appended file 
+// NOTE: dir must be write-locked
+static void eventfs_dir_inode_cursors_catch_up( struct eventfs_dir_inode* dir, struct eventfs_file_deque* ptr ) {
+   
+   for( struct eventfs_cursor* itr = dir->cursors; itr != NULL; itr = itr->next ) {
+      
+      if( itr->pos == NULL ) {
+         eventfs_cursor_retarget( itr, ptr );
+      }
+   }
+}
+
+
 // make the directory empty:
 // * make the deque pointers NULL
 // * detach the symlinks 
@@ -292,6 +1052,7 @@ static int eventfs_dir_inode_set_empty( struct fskit_core* core, char const* dir
         if( head_type == FSKIT_ENTRY_TYPE_DEAD ) {
             
             // already destroyed
+            eventfs_dir_inode_retired_free( &dir->retired_head );
             eventfs_safe_free( dir->fent_head );
             dir->fent_head = NULL;
         }
@@ -304,24 +1065,35 @@ static int eventfs_dir_inode_set_empty( struct fskit_core* core, char const* dir
             }
             
             fskit_entry_wlock( dir->fent_head );
+            eventfs_dir_inode_retired_free( &dir->retired_head );
             
             rc = fskit_entry_detach_lowlevel( dent, "head" );
             
             if( rc == 0 ) {
-                rc = fskit_entry_try_destroy_and_free( core, detach_path, dent, dir->fent_head );
                 
-                if( rc > 0 ) {
-                    // destroyed 
-                    rc = 0;
+                if( dir->spare_head == NULL ) {
+                    
+                    // keep it (and its inode number) for the next time this directory gets a file
+                    fskit_entry_unlock( dir->fent_head );
+                    dir->spare_head = dir->fent_head;
                 }
                 else {
-                    // not destroyed
-                    fskit_entry_unlock( dir->fent_head );
-                    if( rc != 0 ) {
-                        
-                        eventfs_error("fskit_entry_try_destroy_and_free('head') rc = %d\n", rc );
+                    
+                    rc = fskit_entry_try_destroy_and_free( core, detach_path, dent, dir->fent_head );
+                
+                    if( rc > 0 ) {
+                        // destroyed 
                         rc = 0;
                     }
+                    else {
+                        // not destroyed
+                        fskit_entry_unlock( dir->fent_head );
+                        if( rc != 0 ) {
+                        
+                            eventfs_error("fskit_entry_try_destroy_and_free('head') rc = %d\n", rc );
+                            rc = 0;
+                        }
+                    }
                 }
             }
             else {
@@ -347,6 +1119,7 @@ static int eventfs_dir_inode_set_empty( struct fskit_core* core, char const* dir
         if( tail_type == FSKIT_ENTRY_TYPE_DEAD ) {
             
             // tail is already destroyed
+            eventfs_dir_inode_retired_free( &dir->retired_tail );
             eventfs_safe_free( dir->fent_tail );
             dir->fent_tail = NULL;
         }
@@ -359,24 +1132,35 @@ static int eventfs_dir_inode_set_empty( struct fskit_core* core, char const* dir
             }
             
             fskit_entry_wlock( dir->fent_tail );
+            eventfs_dir_inode_retired_free( &dir->retired_tail );
+            
             rc = fskit_entry_detach_lowlevel( dent, "tail" );
             
             if( rc == 0 ) {
-                    
-                rc = fskit_entry_try_destroy_and_free( core, detach_path, dent, dir->fent_tail );
                 
-                if( rc > 0 ) {
-                    // destroyed 
-                    rc = 0;
+                if( dir->spare_tail == NULL ) {
+                    
+                    // keep it (and its inode number) for the next time this directory gets a file
+                    fskit_entry_unlock( dir->fent_tail );
+                    dir->spare_tail = dir->fent_tail;
                 }
                 else {
-                    // not destroyed
-                    fskit_entry_unlock( dir->fent_tail );
-                    if( rc != 0 ) {
-                        
-                        eventfs_error("fskit_entry_try_destroy_and_free('tail') rc = %d\n", rc );
+                    
+                    rc = fskit_entry_try_destroy_and_free( core, detach_path, dent, dir->fent_tail );
+                
+                    if( rc > 0 ) {
+                        // destroyed 
                         rc = 0;
                     }
+                    else {
+                        // not destroyed
+                        fskit_entry_unlock( dir->fent_tail );
+                        if( rc != 0 ) {
+                        
+                            eventfs_error("fskit_entry_try_destroy_and_free('tail') rc = %d\n", rc );
+                            rc = 0;
+                        }
+                    }
                 }
             }
             else {
@@ -393,22 +1177,150 @@ static int eventfs_dir_inode_set_empty( struct fskit_core* core, char const* dir
     }
     
     if( dir->head != NULL ) {
-        eventfs_safe_free( dir->head->name );
+        eventfs_dir_inode_cursors_skip( dir, dir->head );
         eventfs_safe_free( dir->head );
         dir->head = NULL;
     }
     
+    dir->tail = NULL;
+    
+    return 0;
+}
+
+
+// take up to max files off the front of a dead directory's deque, so they can be unlinked a batch at a time.
+// cursors are forgotten, since nothing can read through them anymore.
+// return the taken nodes, oldest first and linked by next (NULL if the deque is empty).  The caller frees them.
+// NOTE: dir must be write-locked, and deleted
+struct eventfs_file_deque* eventfs_dir_inode_drain( struct eventfs_dir_inode* dir, int max ) {
+   
+   struct eventfs_file_deque* batch = dir->head;
+   struct eventfs_file_deque* last = dir->head;
+   
+   if( batch == NULL ) {
+      return NULL;
+   }
+   
+   for( struct eventfs_cursor* itr = dir->cursors; itr != NULL; itr = itr->next ) {
+      itr->pos = NULL;
+   }
+   
+   for( int i = 1; i < max && last->next != NULL; i++ ) {
+      last = last->next;
+   }
+   
+   dir->head = last->next;
+   if( dir->head != NULL ) {
+      dir->head->prev = NULL;
+   }
+   else {
+      dir->tail = NULL;
+   }
+   
+   last->next = NULL;
+   return batch;
+}
+
+
+// make a deque node for a file, with its name in the same allocation.
+// return the node on success 
+// return NULL on OOM
+static struct eventfs_file_deque* eventfs_file_deque_new( char const* name ) {
+   
+   void* ptr = NULL;
+   size_t name_len = strlen( name );
+   
+   if( posix_memalign( &ptr, EVENTFS_CACHE_LINE_SIZE, sizeof(struct eventfs_file_deque) + name_len + 1 ) != 0 ) {
+      return NULL;
+   }
+   
+   struct eventfs_file_deque* deque = (struct eventfs_file_deque*)ptr;
+   
+   memset( deque, 0, sizeof(struct eventfs_file_deque) );
+   memcpy( deque->name, name, name_len + 1 );
+   
+   return deque;
+}
+
+
+// give a directory that is getting its first file a head or tail symlink that points to it.
+// the spare kept from the last time the directory had files is retargeted and re-attached, if there is one;
+// otherwise, a new symlink is made.
+// return 0 on success, and set *fent 
+// return -ENOMEM on OOM
+// NOTE: dent must be write-locked
+static int eventfs_dir_inode_symlink_attach( struct fskit_core* core, struct fskit_entry* dent, struct fskit_entry** spare, struct eventfs_retired_targets* retired, char const* link_name, char const* target, struct fskit_entry** fent ) {
+    
+    int rc = 0;
+    struct fskit_entry* link = NULL;
+    uint64_t link_id = 0;
+    
+    if( *spare != NULL ) {
+        
+        char* target_dup = strdup( target );
+        if( target_dup == NULL ) {
+            return -ENOMEM;
+        }
+        
+        link = *spare;
+        
+        fskit_entry_wlock( link );
+        
+        // no readers left, since we have it write-locked
+        char* old_target = fskit_entry_swap_symlink_target( link, target_dup );
+        eventfs_safe_free( old_target );
+        eventfs_dir_inode_retired_free( retired );
+        
+        rc = fskit_entry_attach_lowlevel( dent, link, link_name );
+        fskit_entry_unlock( link );
+        
+        if( rc != 0 ) {
+            
+            // still spare
+            return rc;
+        }
+        
+        *spare = NULL;
+        *fent = link;
+        return 0;
+    }
+    
+    link = fskit_entry_new();
+    if( link == NULL ) {
+        return -ENOMEM;
+    }
+    
+    link_id = eventfs_inode_number_alloc();
+    
+    rc = fskit_entry_init_symlink( link, link_id, target );
+    if( rc != 0 ) {
+        
+        eventfs_inode_number_release( link_id );
+        eventfs_safe_free( link );
+        return rc;
+    }
+    
+    rc = fskit_entry_attach_lowlevel( dent, link, link_name );
+    if( rc != 0 ) {
+        
+        eventfs_inode_number_release( link_id );
+        fskit_entry_destroy( core, link, false );
+        eventfs_safe_free( link );
+        return rc;
+    }
+    
+    *fent = link;
     return 0;
 }
 
 
-// insert a file inode into a directory, at the very end of the deque.
+// insert a file inode into a directory, at the very end of the deque, and give it the next sequence number.
 // if needed, allocate and attach the head and tail symlinks.
 // return 0 on success 
 // return -ENOENT if the dir is deleted 
 // return -ENOMEM on OOM
 // NOTE: dent must be write-locked
-int eventfs_dir_inode_append( struct fskit_core* core, struct eventfs_dir_inode* dir, struct fskit_entry* dent, char const* name ) {
+static int eventfs_dir_inode_append_ex( struct fskit_core* core, struct eventfs_dir_inode* dir, struct fskit_entry* dent, char const* name, bool auto_named ) {
     
     int rc = 0;
     if( dir->deleted ) {
@@ -420,105 +1332,59 @@ int eventfs_dir_inode_append( struct fskit_core* core, struct eventfs_dir_inode*
         return -ENOMEM;
     }
     
-    struct eventfs_file_deque* deque = EVENTFS_CALLOC( struct eventfs_file_deque, 1 );
-    char* deque_name = strdup( name );
-    
-    if( deque == NULL || deque_name == NULL ) {
-        eventfs_safe_free( deque );
-        eventfs_safe_free( deque_name );
+    struct eventfs_file_deque* deque = eventfs_file_deque_new( name );
+    if( deque == NULL ) {
+        
+        eventfs_safe_free( name_dup_tail );
         return -ENOMEM;
     }
     
     if( dir->head == NULL && dir->tail == NULL ) {
         
         // directory is empty.
-        // first entry--allocate and attach symlinks
-        struct fskit_entry* fent_head = fskit_entry_new();
-        struct fskit_entry* fent_tail = fskit_entry_new();
-        char* name_dup_head = strdup(name);
-        
-        if( fent_head == NULL || fent_tail == NULL || name_dup_head == NULL ) {
-            
-            eventfs_safe_free( fent_head );
-            eventfs_safe_free( fent_tail );
-            eventfs_safe_free( name_dup_head );
-            eventfs_safe_free( name_dup_tail );
-            eventfs_safe_free( deque );
-            eventfs_safe_free( deque_name );
-            return -ENOMEM;
-        }
-        
-        uint64_t head_inode_number = fskit_core_inode_alloc( core, dent, fent_head );
-        uint64_t tail_inode_number = fskit_core_inode_alloc( core, dent, fent_tail );
-    
-        rc = fskit_entry_init_symlink( fent_head, head_inode_number, name_dup_head );
-        eventfs_safe_free( name_dup_head );
-        
-        if( rc != 0 ) {
-           
-            fskit_core_inode_free( core, head_inode_number );
-            fskit_core_inode_free( core, tail_inode_number );
-            eventfs_safe_free( fent_head );
-            eventfs_safe_free( fent_tail );
-            eventfs_safe_free( name_dup_tail );
-            eventfs_safe_free( deque );
-            eventfs_safe_free( deque_name );
-            return rc;
-        }
+        // first entry--attach symlinks, reusing whichever ones it kept from the last time it had files
+        struct fskit_entry* fent_head = NULL;
+        struct fskit_entry* fent_tail = NULL;
         
-        rc = fskit_entry_init_symlink( fent_tail, tail_inode_number, name_dup_tail );
         eventfs_safe_free( name_dup_tail );
         
+        rc = eventfs_dir_inode_symlink_attach( core, dent, &dir->spare_head, &dir->retired_head, "head", name, &fent_head );
         if( rc != 0 ) {
             
-            fskit_entry_destroy( core, fent_head, false );
-            fskit_core_inode_free( core, tail_inode_number );
-            eventfs_safe_free( fent_head );
-            eventfs_safe_free( fent_tail );
             eventfs_safe_free( deque );
-            eventfs_safe_free( deque_name );
             return rc;
         }
         
-        rc = fskit_entry_attach_lowlevel( dent, fent_head, "head" );
+        rc = eventfs_dir_inode_symlink_attach( core, dent, &dir->spare_tail, &dir->retired_tail, "tail", name, &fent_tail );
         if( rc != 0 ) {
             
-            fskit_entry_destroy( core, fent_head, false );
-            fskit_entry_destroy( core, fent_tail, false );
-            eventfs_safe_free( fent_head );
-            eventfs_safe_free( fent_tail );
-            eventfs_safe_free( deque );
-            return rc;
-        }
-        
-        rc = fskit_entry_attach_lowlevel( dent, fent_tail, "tail" );
-        if( rc != 0 ) {
+            // keep head for next time (its spare slot is free, since we just took it or never had one)
+            fskit_entry_detach_lowlevel( dent, "head" );
+            dir->spare_head = fent_head;
             
-            fskit_entry_destroy( core, fent_head, false );
-            fskit_entry_destroy( core, fent_tail, false );
-            eventfs_safe_free( fent_head );
-            eventfs_safe_free( fent_tail );
             eventfs_safe_free( deque );
-            eventfs_safe_free( deque_name );
             return rc;
         }
         
         dir->fent_head = fent_head;
         dir->fent_tail = fent_tail;
         
-        deque->name = deque_name;
+        deque->seq = dir->next_seq++;
+        deque->auto_named = auto_named;
         deque->prev = NULL;
         deque->next = NULL;
         
         dir->head = deque;
         dir->tail = deque;
         
-        return rc;
+        eventfs_dir_inode_cursors_catch_up( dir, deque );
+        return 0;
     }
     else {
         
         // second or more
-        deque->name = deque_name;
+        deque->seq = dir->next_seq++;
+        deque->auto_named = auto_named;
         deque->next = NULL;
         deque->prev = dir->tail;
         
@@ -527,35 +1393,118 @@ int eventfs_dir_inode_append( struct fskit_core* core, struct eventfs_dir_inode*
         
         // retarget tail symlink target
         eventfs_dir_inode_retarget_tail( dir, name_dup_tail );
+        
+        eventfs_dir_inode_cursors_catch_up( dir, deque );
         return 0;
     }
 }
 
 
-// remove a file inode from a directory that is neither the head or tail symlink.
+// insert a file into a directory, at the very end of the deque.
 // return 0 on success 
+// return -ENOENT if the dir is deleted 
 // return -ENOMEM on OOM
-int eventfs_dir_inode_remove( struct fskit_core* core, char const* dir_path, struct eventfs_dir_inode* dir, struct fskit_entry* dent, char const* name ) {
+// NOTE: dent must be write-locked
+int eventfs_dir_inode_append( struct fskit_core* core, struct eventfs_dir_inode* dir, struct fskit_entry* dent, char const* name ) {
     
-    int rc = 0;
+    return eventfs_dir_inode_append_ex( core, dir, dent, name, false );
+}
+
+
+// insert an auto-sequenced file into a directory, at the very end of the deque.
+// name must have come from eventfs_dir_inode_next_seq_name(), with dent write-locked the whole time.
+// return 0 on success 
+// return -ENOENT if the dir is deleted 
+// return -ENOMEM on OOM
+// NOTE: dent must be write-locked
+int eventfs_dir_inode_append_seq( struct fskit_core* core, struct eventfs_dir_inode* dir, struct fskit_entry* dent, char const* name ) {
+    
+    return eventfs_dir_inode_append_ex( core, dir, dent, name, true );
+}
+
+
+// get the name of the next auto-sequenced file, skipping sequence numbers whose names are already taken.
+// name must have room for EVENTFS_SEQ_NAME_LEN+1 bytes
+// return 0 on success 
+// return -ENOENT if the dir is deleted 
+// NOTE: dent must be write-locked
+int eventfs_dir_inode_next_seq_name( struct eventfs_dir_inode* dir, struct fskit_entry* dent, char* name ) {
     
     if( dir->deleted ) {
         return -ENOENT;
     }
     
-    // is this the last file?
-    if( dir->head == dir->tail && dir->head != NULL ) {
+    while( true ) {
         
-        // destroy head and tail symlink
-        rc = eventfs_dir_inode_set_empty( core, dir_path, dir, dent );
+        snprintf( name, EVENTFS_SEQ_NAME_LEN+1, "%0*" PRIu64, EVENTFS_SEQ_NAME_LEN, dir->next_seq );
         
-        return rc;
+        if( fskit_dir_find_by_name( dent, name ) == NULL ) {
+            break;
+        }
+        
+        // someone created a file with this name directly 
+        dir->next_seq++;
     }
-    else {
+    
+    return 0;
+}
+
+
+// parse an auto-sequenced file name into its sequence number 
+// return true if name has the form of an auto-sequenced name, and set *seq 
+// return false if not 
+static bool eventfs_seq_name_parse( char const* name, uint64_t* seq ) {
+    
+    uint64_t val = 0;
+    
+    for( int i = 0; i < EVENTFS_SEQ_NAME_LEN; i++ ) {
+        
+        if( name[i] < '0' || name[i] > '9' ) {
+            return false;
+        }
+        
+        val = val * 10 + (name[i] - '0');
+    }
+    
+    if( name[EVENTFS_SEQ_NAME_LEN] != '\0' ) {
+        return false;
+    }
+    
+    *seq = val;
+    return true;
+}
+
+
+// remove a file inode from a directory that is neither the head or tail symlink.
+// auto-sequenced files are matched by sequence number; all others by name.
+// return 0 on success 
+// return -ENOENT if there is no such file in the deque
+// return -ENOMEM on OOM
+int eventfs_dir_inode_remove( struct fskit_core* core, char const* dir_path, struct eventfs_dir_inode* dir, struct fskit_entry* dent, char const* name ) {
+    
+    int rc = 0;
+    uint64_t seq = 0;
+    bool is_seq_name = false;
+    
+    if( dir->deleted ) {
+        return -ENOENT;
+    }
+    
+    is_seq_name = eventfs_seq_name_parse( name, &seq );
+    
+    for( struct eventfs_file_deque* ptr = dir->head; ptr != NULL; ptr = ptr->next ) {
         
-        for( struct eventfs_file_deque* ptr = dir->head; ptr != NULL; ptr = ptr->next ) {
+        if( ptr->auto_named ? (is_seq_name && ptr->seq == seq) : (strcmp( ptr->name, name ) == 0) ) {
             
-            if( strcmp( ptr->name, name ) == 0 ) {
+            // is this the last file?
+            if( dir->head == dir->tail ) {
+                
+                // destroy head and tail symlink
+                rc = eventfs_dir_inode_set_empty( core, dir_path, dir, dent );
+                
+                return rc;
+            }
+            else {
                 
                 if( ptr == dir->head ) {
                     
@@ -575,6 +1524,9 @@ int eventfs_dir_inode_remove( struct fskit_core* core, char const* dir_path, str
                     // shrink deque
                     dir->head = dir->head->next;
                     dir->head->prev = NULL;
+                    
+                    // the new head may have been waiting on this one to expire
+                    eventfs_ttl_rearm( (struct eventfs_state*)fskit_core_get_user_data( core ), dir );
                 }
                 else if( ptr == dir->tail ) {
                     
@@ -604,7 +1556,7 @@ int eventfs_dir_inode_remove( struct fskit_core* core, char const* dir_path, str
                 }
                 
                 // delete this 
-                eventfs_safe_free( ptr->name );
+                eventfs_dir_inode_cursors_skip( dir, ptr );
                 eventfs_safe_free( ptr );
                 
                 return rc;
@@ -665,6 +1617,8 @@ int eventfs_dir_inode_pophead( struct fskit_core* core, char const* dir_path, st
     fskit_entry_wlock( fent );
     
     fskit_entry_detach_lowlevel( dent, dir->head->name );
+    eventfs_journal_log_remove( eventfs, target_path, dir );
+    
     rc = fskit_entry_try_destroy_and_free( core, target_path, dent, fent );
     
     if( rc > 0 ) {
@@ -753,6 +1707,8 @@ int eventfs_dir_inode_poptail( struct fskit_core* core, char const* dir_path, st
     fskit_entry_wlock( fent );
     
     fskit_entry_detach_lowlevel( dent, dir->tail->name );
+    eventfs_journal_log_remove( eventfs, target_path, dir );
+    
     rc = fskit_entry_try_destroy_and_free( core, target_path, dent, fent );
     
     if( rc > 0 ) {
@@ -850,10 +1806,143 @@ int eventfs_dir_inode_rename_child( struct fskit_core* core, struct eventfs_dir_
 }
 */
 
+// add a cursor to a directory, starting at its head 
+// return 0 on success 
+// return -ENOENT if the directory is deleted 
+// NOTE: dir must be write-locked
+int eventfs_dir_inode_cursor_add( struct eventfs_dir_inode* dir, struct eventfs_cursor* cursor ) {
+   
+   if( dir->deleted ) {
+      return -ENOENT;
+   }
+   
+   cursor->next = dir->cursors;
+   dir->cursors = cursor;
+   dir->num_cursors++;
+   
+   eventfs_cursor_retarget( cursor, dir->head );
+   return 0;
+}
+
+
+// take a cursor out of a directory
+// return 0 on success 
+// return -ENOENT if it is not in the directory
+// NOTE: dir must be write-locked
+int eventfs_dir_inode_cursor_remove( struct eventfs_dir_inode* dir, struct eventfs_cursor* cursor ) {
+   
+   struct eventfs_cursor** itr = &dir->cursors;
+   
+   while( *itr != NULL ) {
+      
+      if( *itr == cursor ) {
+         
+         *itr = cursor->next;
+         cursor->next = NULL;
+         cursor->pos = NULL;
+         dir->num_cursors--;
+         return 0;
+      }
+      
+      itr = &(*itr)->next;
+   }
+   
+   return -ENOENT;
+}
+
+
+// move a cursor past the named file, or past its current file if name is NULL or empty.
+// return 0 on success 
+// return -ENOENT if the cursor already passed the named file, or it is not in the directory
+// return -ENOMEM on OOM
+// NOTE: dir must be write-locked
+int eventfs_dir_inode_cursor_advance( struct eventfs_dir_inode* dir, struct eventfs_cursor* cursor, char const* name ) {
+   
+   struct eventfs_file_deque* ptr = cursor->pos;
+   
+   if( dir->deleted ) {
+      return -ENOENT;
+   }
+   
+   if( ptr == NULL ) {
+      
+      // caught up
+      return (name == NULL || name[0] == '\0' ? 0 : -ENOENT);
+   }
+   
+   if( name != NULL && name[0] != '\0' ) {
+      
+      while( ptr != NULL && strcmp( ptr->name, name ) != 0 ) {
+         ptr = ptr->next;
+      }
+      
+      if( ptr == NULL ) {
+         return -ENOENT;
+      }
+   }
+   
+   return eventfs_cursor_retarget( cursor, ptr->next );
+}
+
+
+// unlink the oldest files in the directory that every cursor has passed 
+// return 0 on success, including if there are no cursors
+// return negative if we failed to pop the head
+// NOTE: dent must be write-locked
+int eventfs_dir_inode_cursor_reclaim( struct fskit_core* core, char const* dir_path, struct eventfs_dir_inode* dir, struct fskit_entry* dent ) {
+   
+   int rc = 0;
+   struct eventfs_file_deque* old_head = NULL;
+   bool passed = false;
+   
+   while( dir->cursors != NULL && dir->head != NULL ) {
+      
+      // cursors only ever point into the deque, so the head is passed iff no cursor is on it
+      passed = true;
+      for( struct eventfs_cursor* itr = dir->cursors; itr != NULL; itr = itr->next ) {
+         
+         if( itr->pos == dir->head ) {
+            
+            passed = false;
+            break;
+         }
+      }
+      
+      if( !passed ) {
+         break;
+      }
+      
+      old_head = dir->head;
+      
+      rc = eventfs_dir_inode_pophead( core, dir_path, dir, dent );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_dir_inode_pophead('%s') rc = %d\n", dir_path, rc );
+         break;
+      }
+      
+      if( dir->head == old_head ) {
+         
+         // someone has it open, so it was detached but not destroyed.  Drop it from the deque anyway.
+         rc = eventfs_dir_inode_remove( core, dir_path, dir, dent, old_head->name );
+         if( rc != 0 ) {
+            
+            eventfs_error("eventfs_dir_inode_remove('%s') rc = %d\n", dir_path, rc );
+            break;
+         }
+      }
+   }
+   
+   return rc;
+}
+
+
 // retarget the 'head' symlink
 // return 0 on success
 // return -ENOENT if the directory is marked as deleted
 // NOTE: takes ownership of the 'target' memory ('target' should be malloc'ed)
+// NOTE: the head symlink must not be locked
+// NOTE: the old target is retired, and freed once no readlink can still be copying it
 int eventfs_dir_inode_retarget_head( struct eventfs_dir_inode* dir, char* target ) {
     
     int rc = 0;
@@ -861,11 +1950,7 @@ int eventfs_dir_inode_retarget_head( struct eventfs_dir_inode* dir, char* target
         return -ENOENT;
     }
     
-    char* old_target = fskit_entry_swap_symlink_target( dir->fent_head, target );
-    
-    if( old_target != NULL ) {
-        eventfs_safe_free( old_target );
-    }
+    eventfs_dir_inode_swap_target( dir->fent_head, &dir->retired_head, target );
     
     return 0;
 }
@@ -875,6 +1960,8 @@ int eventfs_dir_inode_retarget_head( struct eventfs_dir_inode* dir, char* target
 // return 0 on success 
 // return -ENOENT if the directory is marked as deleted 
 // NOTE: takes ownership of the 'target' memory ('target' should be malloc'ed)
+// NOTE: the tail symlink must not be locked
+// NOTE: the old target is retired, and freed once no readlink can still be copying it
 int eventfs_dir_inode_retarget_tail( struct eventfs_dir_inode* dir, char* target ) {
     
     int rc = 0;
@@ -882,11 +1969,7 @@ int eventfs_dir_inode_retarget_tail( struct eventfs_dir_inode* dir, char* target
         return -ENOENT;
     }
     
-    char* old_target = fskit_entry_swap_symlink_target( dir->fent_tail, target );
-    
-    if( old_target != NULL ) {
-        eventfs_safe_free( old_target );
-    }
+    eventfs_dir_inode_swap_target( dir->fent_tail, &dir->retired_tail, target );
     
     return 0;
 }
@@ -26,6 +26,12 @@
 #include <pstat/libpstat.h>
 
 #include "util.h"
+#include "proc.h"
+#include "cgroup.h"
+
+struct eventfs_ttl;
+struct eventfs_lease;
+struct eventfs_push_req;
 
 #define EVENTFS_PIDFILE_BUF_LEN   50
 
@@ -34,43 +40,205 @@
 #define EVENTFS_VERIFY_SIZE       0x4
 #define EVENTFS_VERIFY_PATH       0x8
 #define EVENTFS_VERIFY_STARTTIME  0x10
+#define EVENTFS_VERIFY_FAST       0x20          // only compare the start time in /proc/<pid>/stat (ignores the other bits)
 
 #define EVENTFS_VERIFY_ALL        0x1F
 
 #define EVENTFS_VERIFY_DEFAULT    (EVENTFS_VERIFY_INODE | EVENTFS_VERIFY_MTIME | EVENTFS_VERIFY_SIZE | EVENTFS_VERIFY_STARTTIME)
 
+// reserved name of the file producers write to in order to have eventfs name the message
+#define EVENTFS_PUSH_NAME         ".push"
+
+// reserved prefix of per-consumer cursor files, e.g. ".cursor.logger"
+#define EVENTFS_CURSOR_PREFIX     ".cursor."
+
+// auto-sequenced messages are named by their zero-padded sequence number
+#define EVENTFS_SEQ_NAME_LEN      20
+
+// inode numbers that eventfs hands out itself come from [BASE, BASE + SPACE), which still fits in a 32-bit st_ino
+#define EVENTFS_INODE_NUMBER_BASE  (1ULL << 31)
+#define EVENTFS_INODE_NUMBER_SPACE (1ULL << 31)
+
+// each thread takes this many fresh inode numbers at a time, and passes on this many recycled ones at a time
+#define EVENTFS_INODE_NUMBER_BATCH 4096
+
+// deque nodes are aligned to this
+#define EVENTFS_CACHE_LINE_SIZE   64
+
+// message bodies are stored in chunks of this many bytes
+#define EVENTFS_CHUNK_SIZE        4096
+
+// swapped-out head and tail targets are freed this many at a time, once readers of them have drained
+#define EVENTFS_RETIRE_BATCH      16
+
+// message bodies up to this many bytes are stored in the inode itself
+#ifndef EVENTFS_INLINE_SIZE
+#define EVENTFS_INLINE_SIZE       64
+#endif
+
+// file inode flags
+#define EVENTFS_FILE_PUSH         0x1
+#define EVENTFS_FILE_STAGED       0x2           // not yet in the deque; published when its writer closes or fsyncs it
+#define EVENTFS_FILE_CURSOR       0x4           // a consumer's cursor over the deque
+#define EVENTFS_FILE_DIRTY        0x8           // written since it was last journaled
+#define EVENTFS_FILE_LEASE        0x10          // a directory's .lease file (holds no data)
+
+// file handle types
+#define EVENTFS_HANDLE_PUSH       1             // stages a message written to .push
+#define EVENTFS_HANDLE_STAGED     2             // the creator of a staged message
+#define EVENTFS_HANDLE_CURSOR     3             // advances a cursor on close
+
+struct eventfs_file_deque;
+
+// a consumer's position in a directory's deque.
+// reading the cursor file yields the name of the next unread file; writing a file's name to it (or nothing) and 
+// closing it moves the cursor past that file (or the next one).  Files are reclaimed once every cursor has passed them.
+struct eventfs_cursor {
+   pthread_mutex_t lock;                                // guards target, for readers that do not hold the directory
+   char* target;                                        // contents of the cursor file: pos's name and a newline (NULL if caught up)
+   struct eventfs_file_deque* pos;                      // next unread file (NULL if caught up).  Only changed with the directory write-locked.
+   struct fskit_entry* fent;                            // the cursor file 
+   struct eventfs_cursor* next;                         // next cursor in the directory
+};
+
 // information for a file inode
 struct eventfs_file_inode {
-   char* contents;                                      // contents of the file
+   char** chunks;                                       // contents of the file, in EVENTFS_CHUNK_SIZE pieces (NULL pieces are holes).  NULL while the contents are inline.
+   uint64_t num_chunks;                                 // number of slots in chunks
+   size_t head_len;                                     // allocated length of chunks[0] (at most EVENTFS_CHUNK_SIZE)
    off_t size;                                          // size of the file
-   size_t contents_len;                                 // size of the contents buffer
+   int flags;                                           // bit flags of EVENTFS_FILE_*
+   struct eventfs_cursor* cursor;                       // cursor state (EVENTFS_FILE_CURSOR only)
+   char inline_contents[EVENTFS_INLINE_SIZE];           // contents of the file, until they outgrow it (zeros past size)
+   struct eventfs_file_inode* limbo_next;               // next inode waiting to be freed, once it is in limbo
+};
+
+// per-open state for a handle that publishes a message on close.
+// a .push handle stages the message body itself, and publishes it under the next sequence number.
+// a staged handle publishes the file it was created with.
+struct eventfs_file_handle {
+   int type;                                            // one of EVENTFS_HANDLE_*
+   struct eventfs_file_inode* staged;                   // message body (EVENTFS_HANDLE_PUSH), or name to advance past (EVENTFS_HANDLE_CURSOR)
+   uid_t owner;                                         // owner of the message, once published
+   gid_t group;                                         // group of the message, once published
+   uint64_t dir_generation;                             // generation of the directory the .push handle was opened in (EVENTFS_HANDLE_PUSH only)
+   bool reserved;                                       // if true, then the file its message will become has been charged (EVENTFS_HANDLE_PUSH only)
+   bool dirty;                                          // if true, then the handle was written to
 };
 
 // deque over the set of files in a directory
+// one allocation per file, cache-line aligned, so walking or popping the deque touches one line per file.
+// the file's inode is not part of it:  a hard link puts one inode in a deque twice, an open file's inode
+// outlives its node once it is popped, and staged, .push and cursor inodes never get a node at all.
 struct eventfs_file_deque {
    
-   char* name;
    struct eventfs_file_deque* prev;
    struct eventfs_file_deque* next;
+   uint64_t seq;                                        // position in the directory's sequence
+   uint64_t expires;                                    // timer tick at which this file expires (0 if never)
+   bool auto_named;                                     // if true, then name is the formatted seq
+   char name[];                                         // the file's name
+};
+
+// head or tail targets that have been swapped out, but that a readlink may still be copying
+struct eventfs_retired_targets {
+   char* targets[EVENTFS_RETIRE_BATCH];
+   int count;
+};
+
+// .push publications waiting on one directory, and whether or not a producer is publishing them.
+// producers wait on it without holding the directory, so it is refcounted, and outlives the directory until the last of them lets go.
+struct eventfs_push_queue {
+   pthread_mutex_t lock;
+   pthread_cond_t cond;                                 // broadcast when a batch has been published
+   struct eventfs_push_req* pending;
+   struct eventfs_push_req** pending_tail;
+   bool combining;                                      // if true, then a producer is publishing on everyone's behalf
+   int refs;                                            // the directory's, plus one per producer using it
 };
 
 // information for a directory inode 
 struct eventfs_dir_inode {
-   struct pstat* ps;                                    // process owner status
+   eventfs_proc* proc;                                  // process owner identity (shared with its other directories)
    bool deleted;                                        // if true, then consider the associated fskit entry deleted
+   uint64_t generation;                                 // unique to this directory, even if another one later takes its name (and address)
    int verify_discipline;                               // bit flags of EVENTFS_VERIFY_* that control how strict we are in verifying the accessing process
    
    struct eventfs_file_deque* head;                     // oldest file in this directory
    struct eventfs_file_deque* tail;                     // newest file in this directory
+   uint64_t next_seq;                                   // sequence number of the next appended file
    
    // head and tail symlinks
    struct fskit_entry* fent_head;
    struct fskit_entry* fent_tail;
+   
+   // head and tail symlinks, detached while the directory is empty and re-attached once it gets a file again
+   struct fskit_entry* spare_head;
+   struct fskit_entry* spare_tail;
+   
+   // targets swapped out of fent_head and fent_tail, freed once their readers have drained
+   struct eventfs_retired_targets retired_head;
+   struct eventfs_retired_targets retired_tail;
+   
+   // .push file (NULL until a producer creates it)
+   struct fskit_entry* fent_push;
+   
+   // .push publications in flight
+   struct eventfs_push_queue* push_queue;
+   uint64_t push_reserved;                              // files charged to open .push handles, but not yet published
+   
+   // expiry timer (NULL until a file with a TTL gets appended)
+   struct eventfs_ttl* ttl;
+   
+   // lease timer (NULL unless the owner has touched .lease), and when the lease runs out
+   struct eventfs_lease* lease;
+   uint64_t lease_expires;
+   
+   // consumer cursors.  If there are any, files are reclaimed once they have all passed them.
+   struct eventfs_cursor* cursors;
+   int num_cursors;
+   
+   bool journaled;                                      // if true, then changes to this directory go to the journal
+   
+   // entry in the creator's list of directories (guarded by the process table)
+   char* path;
+   struct eventfs_dir_inode* proc_prev;
+   struct eventfs_dir_inode* proc_next;
+   bool proc_indexed;                                   // if true, then it is in the list
+   
+   // cgroup it shares fate with instead of its creator (NULL if none), and its entry in the cgroup's list of directories
+   eventfs_cgroup* cgroup;
+   struct eventfs_dir_inode* cgroup_prev;
+   struct eventfs_dir_inode* cgroup_next;
+   bool cgroup_indexed;                                 // if true, then it is in the list
+   
+   // entry in the creating user's list of directories (guarded by the owner lock), so a user at quota can reclaim dead ones
+   uid_t owner_uid;
+   struct eventfs_dir_inode* owner_prev;
+   struct eventfs_dir_inode* owner_next;
+   bool owner_indexed;                                  // if true, then it is in the list
+   bool quota_credited;                                 // if true, then its directory was given back to its owner's quota when it was reclaimed
 };
 
 
+uint64_t eventfs_inode_number_alloc( void );
+void eventfs_inode_number_release( uint64_t inode_number );
+
 int eventfs_file_inode_init( struct eventfs_file_inode* inode );
 int eventfs_file_inode_free( struct eventfs_file_inode* inode );
+ssize_t eventfs_file_inode_read( struct eventfs_file_inode* inode, char* buf, size_t buflen, off_t offset );
+ssize_t eventfs_file_inode_write( struct eventfs_file_inode* inode, char const* buf, size_t buflen, off_t offset );
+int eventfs_file_inode_truncate( struct eventfs_file_inode* inode, off_t new_size );
+
+struct eventfs_cursor* eventfs_cursor_new( struct fskit_entry* fent );
+int eventfs_cursor_free( struct eventfs_cursor* cursor );
+int eventfs_cursor_read( struct eventfs_cursor* cursor, char* buf, size_t buflen, off_t offset );
+
+struct eventfs_file_handle* eventfs_file_handle_new( int type, uid_t owner, gid_t group );
+int eventfs_file_handle_free( struct eventfs_file_handle* handle );
+
+struct eventfs_push_queue* eventfs_push_queue_ref( struct eventfs_push_queue* queue );
+int eventfs_push_queue_unref( struct eventfs_push_queue* queue );
 
 int eventfs_dir_inode_init( struct eventfs_dir_inode* inode, pid_t pid, int verify_discipline );
 int eventfs_dir_inode_free( struct fskit_core* core, struct eventfs_dir_inode* inode );
@@ -81,6 +249,13 @@ int eventfs_dir_inode_remove( struct fskit_core* core, char const* dir_path, str
 int eventfs_dir_inode_pophead( struct fskit_core* core, char const* dir_path, struct eventfs_dir_inode* dir, struct fskit_entry* dent );
 int eventfs_dir_inode_poptail( struct fskit_core* core, char const* dir_path, struct eventfs_dir_inode* dir, struct fskit_entry* dent );
 int eventfs_dir_inode_is_empty( struct eventfs_dir_inode* dir );
+int eventfs_dir_inode_next_seq_name( struct eventfs_dir_inode* dir, struct fskit_entry* dent, char* name );
+int eventfs_dir_inode_append_seq( struct fskit_core* core, struct eventfs_dir_inode* dir, struct fskit_entry* dent, char const* name );
+int eventfs_dir_inode_cursor_add( struct eventfs_dir_inode* dir, struct eventfs_cursor* cursor );
+int eventfs_dir_inode_cursor_remove( struct eventfs_dir_inode* dir, struct eventfs_cursor* cursor );
+int eventfs_dir_inode_cursor_advance( struct eventfs_dir_inode* dir, struct eventfs_cursor* cursor, char const* name );
+int eventfs_dir_inode_cursor_reclaim( struct fskit_core* core, char const* dir_path, struct eventfs_dir_inode* dir, struct fskit_entry* dent );
+struct eventfs_file_deque* eventfs_dir_inode_drain( struct eventfs_dir_inode* dir, int max );
 // int eventfs_dir_inode_rename_child( struct fskit_core* core, struct eventfs_dir_inode* dir, struct fskit_entry* fent, char const* old_name, char const* new_name );
 
 // keep symlinks consistent 
@@ -88,6 +263,6 @@ int eventfs_dir_inode_retarget_head( struct eventfs_dir_inode* dir, char* target
 int eventfs_dir_inode_retarget_tail( struct eventfs_dir_inode* dir, char* target );
 
 // validity check (on stat and readdir)
-int eventfs_dir_inode_is_valid( struct eventfs_dir_inode* inode );
+int eventfs_dir_inode_is_valid( struct eventfs_dir_inode* inode, int verify_discipline );
 
 #endif 
\ No newline at end of file
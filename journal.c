@@ -0,0 +1,1023 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "journal.h"
+#include "eventfs.h"
+
+#include <sys/uio.h>
+
+// directory xattrs that a DIR record preserves
+static char const* eventfs_journal_dir_xattrs[] = {
+   "user.eventfs_sticky",
+   "user.eventfs_staged",
+   EVENTFS_XATTR_TTL,
+   EVENTFS_XATTR_OVERFLOW,
+   NULL
+};
+
+// longest xattr value we preserve 
+#define EVENTFS_JOURNAL_XATTR_LEN       255
+
+
+// FNV-1a over a record's path and data 
+static uint32_t eventfs_journal_checksum( char const* path, size_t path_len, char const* data, uint64_t data_len ) {
+   
+   uint32_t hash = 2166136261u;
+   
+   for( size_t i = 0; i < path_len; i++ ) {
+      
+      hash ^= (uint8_t)path[i];
+      hash *= 16777619u;
+   }
+   
+   for( uint64_t i = 0; i < data_len; i++ ) {
+      
+      hash ^= (uint8_t)data[i];
+      hash *= 16777619u;
+   }
+   
+   return hash;
+}
+
+
+// set up a journal that isn't journaling anything yet 
+// return 0 on success 
+// return negative on failure to set up the lock 
+int eventfs_journal_init( struct eventfs_journal* journal ) {
+   
+   int rc = 0;
+   
+   memset( journal, 0, sizeof(struct eventfs_journal) );
+   
+   rc = pthread_mutex_init( &journal->lock, NULL );
+   if( rc != 0 ) {
+      return -abs(rc);
+   }
+   
+   journal->fd = -1;
+   return 0;
+}
+
+
+// flush and stop journaling 
+// always succeeds
+int eventfs_journal_close( struct eventfs_journal* journal ) {
+   
+   eventfs_journal_sync( journal );
+   
+   pthread_mutex_lock( &journal->lock );
+   
+   if( journal->fd >= 0 ) {
+      
+      close( journal->fd );
+      journal->fd = -1;
+   }
+   
+   pthread_mutex_unlock( &journal->lock );
+   return 0;
+}
+
+
+// are we journaling at all?
+// the fd is set and cleared under the journal lock, so read it under the lock too
+static bool eventfs_journal_is_open( struct eventfs_journal* journal ) {
+   
+   bool open = false;
+   
+   pthread_mutex_lock( &journal->lock );
+   open = (journal->fd >= 0);
+   pthread_mutex_unlock( &journal->lock );
+   
+   return open;
+}
+
+
+// make everything journaled so far durable.
+// called once per timer tick, so one fsync covers every record written during it.
+// the fsync happens without the journal locked, so loggers don't wait on it.
+// return 0 on success 
+// return -errno on failure to fsync
+int eventfs_journal_sync( struct eventfs_journal* journal ) {
+   
+   int rc = 0;
+   int fd = -1;
+   bool dirty = false;
+   
+   pthread_mutex_lock( &journal->lock );
+   
+   if( journal->fd >= 0 ) {
+      
+      fd = journal->fd;
+      dirty = journal->dirty;
+      journal->dirty = false;
+   }
+   
+   pthread_mutex_unlock( &journal->lock );
+   
+   // NOTE: the fd is only closed once the tick that calls this is stopped
+   if( dirty && fdatasync( fd ) != 0 ) {
+      
+      rc = -errno;
+      eventfs_error("fdatasync(journal) rc = %d\n", rc );
+      
+      pthread_mutex_lock( &journal->lock );
+      journal->dirty = true;
+      pthread_mutex_unlock( &journal->lock );
+   }
+   
+   return rc;
+}
+
+
+// fill in a record header, optionally tagged with the process that created the directory it describes
+static void eventfs_journal_record_init( struct eventfs_journal_record* rec, int type, char const* path, mode_t mode, uid_t owner, gid_t group, struct pstat* creator, char const* data, uint64_t data_len ) {
+   
+   memset( rec, 0, sizeof(struct eventfs_journal_record) );
+   
+   rec->magic = EVENTFS_JOURNAL_MAGIC;
+   rec->type = type;
+   rec->mode = mode;
+   rec->owner = owner;
+   rec->group = group;
+   rec->path_len = strlen(path);
+   rec->data_len = data_len;
+   rec->checksum = eventfs_journal_checksum( path, rec->path_len, data, data_len );
+   
+   if( creator != NULL ) {
+      
+      rec->pid = pstat_get_pid( creator );
+      rec->starttime = pstat_get_starttime( creator );
+   }
+}
+
+
+// write one record to a file descriptor, optionally tagged with the process that created the directory it describes
+// return 0 on success 
+// return -errno on I/O error
+static int eventfs_journal_write_ex( int fd, int type, char const* path, mode_t mode, uid_t owner, gid_t group, struct pstat* creator, char const* data, uint64_t data_len ) {
+   
+   struct eventfs_journal_record rec;
+   struct iovec iov[3];
+   struct iovec* iov_itr = iov;
+   int iov_cnt = 3;
+   ssize_t nw = 0;
+   
+   eventfs_journal_record_init( &rec, type, path, mode, owner, group, creator, data, data_len );
+   
+   iov[0].iov_base = &rec;
+   iov[0].iov_len = sizeof(struct eventfs_journal_record);
+   iov[1].iov_base = (void*)path;
+   iov[1].iov_len = rec.path_len;
+   iov[2].iov_base = (void*)data;
+   iov[2].iov_len = data_len;
+   
+   while( iov_cnt > 0 ) {
+      
+      nw = writev( fd, iov_itr, iov_cnt );
+      if( nw < 0 ) {
+         
+         if( errno == EINTR ) {
+            continue;
+         }
+         
+         return -errno;
+      }
+      
+      // skip what got written 
+      while( iov_cnt > 0 && (size_t)nw >= iov_itr->iov_len ) {
+         
+         nw -= iov_itr->iov_len;
+         iov_itr++;
+         iov_cnt--;
+      }
+      
+      if( iov_cnt > 0 ) {
+         
+         iov_itr->iov_base = (char*)iov_itr->iov_base + nw;
+         iov_itr->iov_len -= nw;
+      }
+   }
+   
+   return 0;
+}
+
+
+// write one record to a file descriptor 
+// return 0 on success 
+// return -errno on I/O error
+static int eventfs_journal_write( int fd, int type, char const* path, mode_t mode, uid_t owner, gid_t group, char const* data, uint64_t data_len ) {
+   
+   return eventfs_journal_write_ex( fd, type, path, mode, owner, group, NULL, data, data_len );
+}
+
+
+// append a record to the journal, if we're journaling.
+// the record is written through, so it survives eventfs crashing; it is fsync'ed on the next tick.
+// return 0 on success 
+// return -errno on I/O error
+static int eventfs_journal_log( struct eventfs_journal* journal, int type, char const* path, mode_t mode, uid_t owner, gid_t group, char const* data, uint64_t data_len ) {
+   
+   int rc = 0;
+   
+   pthread_mutex_lock( &journal->lock );
+   
+   if( journal->fd >= 0 ) {
+      
+      rc = eventfs_journal_write( journal->fd, type, path, mode, owner, group, data, data_len );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_journal_write('%s') rc = %d\n", path, rc );
+      }
+      else {
+         
+         journal->dirty = true;
+      }
+   }
+   
+   pthread_mutex_unlock( &journal->lock );
+   return rc;
+}
+
+
+// serialize a directory's eventfs xattrs as name\0value\0 pairs 
+// return 0 on success, and set *data and *data_len (*data may be NULL if there are none)
+// return -ENOMEM on OOM 
+static int eventfs_journal_get_dir_xattrs( struct fskit_core* core, char const* dir_path, struct fskit_entry* dent, char** data, uint64_t* data_len ) {
+   
+   int rc = 0;
+   char value[EVENTFS_JOURNAL_XATTR_LEN+1];
+   char* buf = NULL;
+   char* tmp = NULL;
+   uint64_t len = 0;
+   size_t name_len = 0;
+   
+   for( int i = 0; eventfs_journal_dir_xattrs[i] != NULL; i++ ) {
+      
+      memset( value, 0, EVENTFS_JOURNAL_XATTR_LEN+1 );
+      
+      rc = fskit_fgetxattr( core, dir_path, dent, eventfs_journal_dir_xattrs[i], value, EVENTFS_JOURNAL_XATTR_LEN );
+      if( rc < 0 ) {
+         
+         // not set 
+         continue;
+      }
+      
+      name_len = strlen( eventfs_journal_dir_xattrs[i] );
+      
+      tmp = (char*)realloc( buf, len + name_len + 1 + strlen(value) + 1 );
+      if( tmp == NULL ) {
+         
+         eventfs_safe_free( buf );
+         return -ENOMEM;
+      }
+      
+      buf = tmp;
+      
+      memcpy( buf + len, eventfs_journal_dir_xattrs[i], name_len + 1 );
+      len += name_len + 1;
+      
+      memcpy( buf + len, value, strlen(value) + 1 );
+      len += strlen(value) + 1;
+   }
+   
+   *data = buf;
+   *data_len = len;
+   return 0;
+}
+
+
+// copy out a file's body 
+// return 0 on success, and set *body and *body_len (*body is NULL if it's empty)
+// return -ENOMEM on OOM
+static int eventfs_journal_get_body( struct eventfs_file_inode* inode, char** body, uint64_t* body_len ) {
+   
+   char* buf = NULL;
+   off_t off = 0;
+   ssize_t nr = 0;
+   
+   *body = NULL;
+   *body_len = 0;
+   
+   if( inode->size <= 0 ) {
+      return 0;
+   }
+   
+   buf = EVENTFS_CALLOC( char, inode->size );
+   if( buf == NULL ) {
+      return -ENOMEM;
+   }
+   
+   while( off < inode->size ) {
+      
+      nr = eventfs_file_inode_read( inode, buf + off, inode->size - off, off );
+      if( nr <= 0 ) {
+         break;
+      }
+      
+      off += nr;
+   }
+   
+   *body = buf;
+   *body_len = off;
+   return 0;
+}
+
+
+// write a directory's DIR record, either to fd or (if fd is negative) to the journal.
+// creator is the process the directory shares fate with, or NULL if it is sticky.
+// return 0 on success
+// return -ENOMEM on OOM
+// return -errno on I/O error
+static int eventfs_journal_write_dir( struct eventfs_state* eventfs, int fd, char const* dir_path, struct fskit_entry* dent, struct pstat* creator ) {
+   
+   int rc = 0;
+   char* xattrs = NULL;
+   uint64_t xattrs_len = 0;
+   
+   rc = eventfs_journal_get_dir_xattrs( eventfs->core, dir_path, dent, &xattrs, &xattrs_len );
+   if( rc != 0 ) {
+      return rc;
+   }
+   
+   if( fd >= 0 ) {
+      rc = eventfs_journal_write_ex( fd, EVENTFS_JOURNAL_DIR, dir_path, fskit_entry_get_mode( dent ), fskit_entry_get_owner( dent ), fskit_entry_get_group( dent ), creator, xattrs, xattrs_len );
+   }
+   else {
+      rc = eventfs_journal_log( &eventfs->journal, EVENTFS_JOURNAL_DIR, dir_path, fskit_entry_get_mode( dent ), fskit_entry_get_owner( dent ), fskit_entry_get_group( dent ), xattrs, xattrs_len );
+   }
+   
+   eventfs_safe_free( xattrs );
+   return rc;
+}
+
+
+// journal a file that just joined a directory's deque, and its body if we have it already.
+// the first file to join a sticky directory journals the directory too; files in other directories are not journaled.
+// return 0 on success, or if we're not journaling this directory 
+// return -ENOMEM on OOM 
+// return -errno on I/O error
+// NOTE: dent must be write-locked
+int eventfs_journal_log_append( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* dent, struct eventfs_dir_inode* dir, struct fskit_entry* fent, char const* name, struct eventfs_file_inode* body ) {
+   
+   int rc = 0;
+   char* path = NULL;
+   char* data = NULL;
+   uint64_t data_len = 0;
+   
+   if( !eventfs_journal_is_open( &eventfs->journal ) ) {
+      return 0;
+   }
+   
+   if( !dir->journaled ) {
+      
+      rc = fskit_fgetxattr( eventfs->core, dir_path, dent, "user.eventfs_sticky", NULL, 0 );
+      if( rc < 0 ) {
+         
+         // dies with its creator anyway
+         return 0;
+      }
+      
+      rc = eventfs_journal_write_dir( eventfs, -1, dir_path, dent, NULL );
+      if( rc != 0 ) {
+         return rc;
+      }
+      
+      dir->journaled = true;
+   }
+   
+   path = fskit_fullpath( dir_path, name, NULL );
+   if( path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   rc = eventfs_journal_log( &eventfs->journal, EVENTFS_JOURNAL_APPEND, path, fskit_entry_get_mode( fent ), fskit_entry_get_owner( fent ), fskit_entry_get_group( fent ), NULL, 0 );
+   if( rc == 0 && body != NULL && body->size > 0 ) {
+      
+      rc = eventfs_journal_get_body( body, &data, &data_len );
+      if( rc == 0 ) {
+         
+         rc = eventfs_journal_log( &eventfs->journal, EVENTFS_JOURNAL_DATA, path, fskit_entry_get_mode( fent ), fskit_entry_get_owner( fent ), fskit_entry_get_group( fent ), data, data_len );
+         eventfs_safe_free( data );
+      }
+   }
+   
+   eventfs_safe_free( path );
+   return rc;
+}
+
+
+// journal a file's body, if it was written since it was last journaled and its directory is journaled.
+// return 0 on success, or if there is nothing to do
+// return -ENOMEM on OOM 
+// return -errno on I/O error
+// NOTE: neither fent nor its parent may be locked
+int eventfs_journal_log_data( struct eventfs_state* eventfs, char const* path, struct fskit_entry* fent ) {
+   
+   int rc = 0;
+   char* dir_path = NULL;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   struct eventfs_file_inode* inode = NULL;
+   bool journaled = false;
+   char* data = NULL;
+   uint64_t data_len = 0;
+   mode_t mode = 0;
+   uid_t owner = 0;
+   gid_t group = 0;
+   
+   if( !eventfs_journal_is_open( &eventfs->journal ) ) {
+      return 0;
+   }
+   
+   dir_path = fskit_dirname( path, NULL );
+   if( dir_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   dent = fskit_entry_resolve_path( eventfs->core, dir_path, 0, 0, false, &rc );
+   eventfs_safe_free( dir_path );
+   
+   if( dent == NULL ) {
+      return 0;
+   }
+   
+   dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   journaled = (dir != NULL && !dir->deleted && dir->journaled);
+   
+   fskit_entry_unlock( dent );
+   
+   if( !journaled ) {
+      return 0;
+   }
+   
+   fskit_entry_wlock( fent );
+   
+   inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( fent );
+   if( inode == NULL || (inode->flags & EVENTFS_FILE_DIRTY) == 0 || (inode->flags & (EVENTFS_FILE_PUSH | EVENTFS_FILE_STAGED | EVENTFS_FILE_CURSOR | EVENTFS_FILE_LEASE)) != 0 ) {
+      
+      fskit_entry_unlock( fent );
+      return 0;
+   }
+   
+   rc = eventfs_journal_get_body( inode, &data, &data_len );
+   if( rc != 0 ) {
+      
+      fskit_entry_unlock( fent );
+      return rc;
+   }
+   
+   inode->flags &= ~EVENTFS_FILE_DIRTY;
+   mode = fskit_entry_get_mode( fent );
+   owner = fskit_entry_get_owner( fent );
+   group = fskit_entry_get_group( fent );
+   
+   fskit_entry_unlock( fent );
+   
+   rc = eventfs_journal_log( &eventfs->journal, EVENTFS_JOURNAL_DATA, path, mode, owner, group, data, data_len );
+   
+   eventfs_safe_free( data );
+   return rc;
+}
+
+
+// journal a file leaving a journaled directory 
+// return 0 on success, or if the directory is not journaled
+// return -errno on I/O error 
+int eventfs_journal_log_remove( struct eventfs_state* eventfs, char const* path, struct eventfs_dir_inode* dir ) {
+   
+   if( !dir->journaled ) {
+      return 0;
+   }
+   
+   return eventfs_journal_log( &eventfs->journal, EVENTFS_JOURNAL_REMOVE, path, 0, 0, 0, NULL, 0 );
+}
+
+
+// journal the removal of a journaled directory 
+// return 0 on success, or if the directory is not journaled
+// return -errno on I/O error
+int eventfs_journal_log_rmdir( struct eventfs_state* eventfs, char const* path, struct eventfs_dir_inode* dir ) {
+   
+   if( !dir->journaled ) {
+      return 0;
+   }
+   
+   return eventfs_journal_log( &eventfs->journal, EVENTFS_JOURNAL_RMDIR, path, 0, 0, 0, NULL, 0 );
+}
+
+
+// apply one journal record through fskit, as the record's owner
+// return 0 on success, or if the record no longer applies
+// return negative on error
+static int eventfs_journal_apply( struct eventfs_state* eventfs, struct eventfs_journal_record* rec, char const* path, char const* data ) {
+   
+   int rc = 0;
+   struct fskit_core* core = eventfs->core;
+   struct fskit_file_handle* fh = NULL;
+   char const* name = NULL;
+   char const* value = NULL;
+   ssize_t nw = 0;
+   
+   switch( rec->type ) {
+      
+      case EVENTFS_JOURNAL_DIR: {
+         
+         rc = fskit_mkdir( core, path, rec->mode, rec->owner, rec->group );
+         if( rc != 0 && rc != -EEXIST ) {
+            break;
+         }
+         
+         rc = 0;
+         
+         // restore its xattrs 
+         for( uint64_t off = 0; off < rec->data_len; ) {
+            
+            name = data + off;
+            value = name + strnlen( name, rec->data_len - off ) + 1;
+            
+            if( value >= data + rec->data_len ) {
+               break;
+            }
+            
+            rc = fskit_setxattr( core, path, rec->owner, rec->group, name, value, strnlen( value, data + rec->data_len - value ), 0 );
+            if( rc != 0 ) {
+               
+               eventfs_error("fskit_setxattr('%s', '%s') rc = %d\n", path, name, rc );
+               rc = 0;
+            }
+            
+            off = (value - data) + strnlen( value, data + rec->data_len - value ) + 1;
+         }
+         
+         break;
+      }
+      
+      case EVENTFS_JOURNAL_APPEND: {
+         
+         fh = fskit_create( core, path, rec->owner, rec->group, rec->mode, &rc );
+         if( fh != NULL ) {
+            
+            rc = fskit_close( core, fh );
+         }
+         else if( rc == -EEXIST ) {
+            
+            rc = 0;
+         }
+         
+         break;
+      }
+      
+      case EVENTFS_JOURNAL_DATA: {
+         
+         rc = fskit_trunc( core, path, rec->owner, rec->group, 0 );
+         if( rc != 0 ) {
+            break;
+         }
+         
+         fh = fskit_open( core, path, rec->owner, rec->group, O_WRONLY, 0, &rc );
+         if( fh == NULL ) {
+            break;
+         }
+         
+         for( uint64_t off = 0; off < rec->data_len; off += nw ) {
+            
+            nw = fskit_write( core, fh, data + off, rec->data_len - off, off );
+            if( nw <= 0 ) {
+               
+               rc = (nw < 0 ? (int)nw : -EIO);
+               break;
+            }
+         }
+         
+         fskit_close( core, fh );
+         break;
+      }
+      
+      case EVENTFS_JOURNAL_REMOVE: {
+         
+         rc = fskit_unlink( core, path, rec->owner, rec->group );
+         if( rc == -ENOENT ) {
+            rc = 0;
+         }
+         
+         break;
+      }
+      
+      case EVENTFS_JOURNAL_RMDIR: {
+         
+         rc = fskit_rmdir( core, path, rec->owner, rec->group );
+         if( rc == -ENOENT ) {
+            rc = 0;
+         }
+         
+         break;
+      }
+      
+      default: {
+         
+         eventfs_error("Unknown journal record type %u for '%s'\n", rec->type, path );
+         rc = 0;
+         break;
+      }
+   }
+   
+   return rc;
+}
+
+
+// is the process that a snapshotted directory shared fate with still the same process?
+// return true if so 
+// return false if it exited (or its PID got reused) while we were down
+static bool eventfs_journal_creator_alive( pid_t pid, uint64_t starttime ) {
+   
+   bool alive = false;
+   struct pstat* ps = pstat_new();
+   
+   if( ps == NULL ) {
+      return false;
+   }
+   
+   if( pstat( pid, ps, 0 ) == 0 && pstat_is_running( ps ) && pstat_get_starttime( ps ) == starttime ) {
+      alive = true;
+   }
+   
+   pstat_free( ps );
+   return alive;
+}
+
+
+// rebuild directories from a journal or snapshot, by replaying it through fskit.
+// replay stops at the first torn or corrupt record; everything before it is applied.
+// a snapshotted directory whose creator has since died is skipped, along with its files.
+// call this before the filesystem is mounted.
+// return 0 on success, including if there is no journal yet
+// return -ENOMEM on OOM 
+// return -errno on failure to read the journal
+int eventfs_journal_replay( struct eventfs_state* eventfs, char const* path ) {
+   
+   int rc = 0;
+   int fd = -1;
+   struct stat sb;
+   char* map = NULL;
+   uint64_t off = 0;
+   uint64_t num_records = 0;
+   struct eventfs_journal_record rec;
+   char* rec_path = NULL;
+   char* skip_dir = NULL;
+   size_t skip_dir_len = 0;
+   struct eventfs_caller caller;
+   
+   fd = open( path, O_RDONLY );
+   if( fd < 0 ) {
+      
+      rc = -errno;
+      if( rc == -ENOENT ) {
+         
+         // first run
+         return 0;
+      }
+      
+      eventfs_error("open('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+   
+   rc = fstat( fd, &sb );
+   if( rc != 0 ) {
+      
+      rc = -errno;
+      close( fd );
+      return rc;
+   }
+   
+   if( sb.st_size == 0 ) {
+      
+      close( fd );
+      return 0;
+   }
+   
+   map = (char*)mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );
+   
+   if( map == MAP_FAILED ) {
+      
+      rc = -errno;
+      eventfs_error("mmap('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+   
+   while( off + sizeof(struct eventfs_journal_record) <= (uint64_t)sb.st_size ) {
+      
+      memcpy( &rec, map + off, sizeof(struct eventfs_journal_record) );
+      
+      if( rec.magic != EVENTFS_JOURNAL_MAGIC || rec.path_len == 0 || rec.path_len > PATH_MAX ) {
+         
+         eventfs_error("Corrupt journal record at offset %" PRIu64 " of '%s'\n", off, path );
+         break;
+      }
+      
+      if( off + sizeof(struct eventfs_journal_record) + rec.path_len + rec.data_len > (uint64_t)sb.st_size ) {
+         
+         eventfs_error("Torn journal record at offset %" PRIu64 " of '%s'\n", off, path );
+         break;
+      }
+      
+      char const* rec_path_buf = map + off + sizeof(struct eventfs_journal_record);
+      char const* rec_data = rec_path_buf + rec.path_len;
+      
+      if( eventfs_journal_checksum( rec_path_buf, rec.path_len, rec_data, rec.data_len ) != rec.checksum ) {
+         
+         eventfs_error("Journal record checksum mismatch at offset %" PRIu64 " of '%s'\n", off, path );
+         break;
+      }
+      
+      rec_path = strndup( rec_path_buf, rec.path_len );
+      if( rec_path == NULL ) {
+         
+         rc = -ENOMEM;
+         break;
+      }
+      
+      off += sizeof(struct eventfs_journal_record) + rec.path_len + rec.data_len;
+      num_records++;
+      
+      if( skip_dir != NULL && strncmp( rec_path, skip_dir, skip_dir_len ) == 0 && (rec_path[skip_dir_len] == '/' || rec_path[skip_dir_len] == '\0') ) {
+         
+         // belongs to a dead process's directory
+         eventfs_safe_free( rec_path );
+         continue;
+      }
+      
+      if( rec.type == EVENTFS_JOURNAL_DIR && rec.pid != 0 ) {
+         
+         if( !eventfs_journal_creator_alive( rec.pid, rec.starttime ) ) {
+            
+            eventfs_debug("Creator %u of '%s' is gone; not restoring it\n", rec.pid, rec_path );
+            
+            eventfs_safe_free( skip_dir );
+            skip_dir = rec_path;
+            skip_dir_len = strlen( skip_dir );
+            continue;
+         }
+      }
+      
+      // act as the record's owner (and for a snapshotted directory, as its creator)
+      caller.pid = (rec.type == EVENTFS_JOURNAL_DIR && rec.pid != 0 ? (pid_t)rec.pid : getpid());
+      caller.uid = rec.owner;
+      caller.gid = rec.group;
+      eventfs_caller_set( &caller );
+      
+      rc = eventfs_journal_apply( eventfs, &rec, rec_path, rec_data );
+      
+      eventfs_caller_set( NULL );
+      
+      if( rc != 0 ) {
+         
+         eventfs_error("Failed to replay journal record %u for '%s', rc = %d\n", rec.type, rec_path, rc );
+         rc = 0;
+      }
+      
+      eventfs_safe_free( rec_path );
+   }
+   
+   munmap( map, sb.st_size );
+   eventfs_safe_free( skip_dir );
+   
+   eventfs_debug("Replayed %" PRIu64 " journal records from '%s'\n", num_records, path );
+   return rc;
+}
+
+
+// write an image of the current state of every sticky directory (or if everything is true, of every directory),
+// as a sequence of journal records, and atomically put it at path.
+// return 0 on success 
+// return -ENOMEM on OOM 
+// return -errno on I/O error
+static int eventfs_journal_write_image( struct eventfs_state* eventfs, char const* path, bool everything ) {
+   
+   int rc = 0;
+   int fd = -1;
+   int dir_fd = -1;
+   char* checkpoint_path = NULL;
+   char* journal_dir = NULL;
+   struct fskit_dir_entry** dirents = NULL;
+   uint64_t num_dirents = 0;
+   struct fskit_entry* dent = NULL;
+   struct fskit_entry* child = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   struct eventfs_file_inode* inode = NULL;
+   char* dir_path = NULL;
+   char* file_path = NULL;
+   char* body = NULL;
+   uint64_t body_len = 0;
+   bool sticky = false;
+   
+   checkpoint_path = EVENTFS_CALLOC( char, strlen(path) + strlen(EVENTFS_JOURNAL_CHECKPOINT_SUFFIX) + 1 );
+   if( checkpoint_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   sprintf( checkpoint_path, "%s%s", path, EVENTFS_JOURNAL_CHECKPOINT_SUFFIX );
+   
+   fd = open( checkpoint_path, O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+   if( fd < 0 ) {
+      
+      rc = -errno;
+      eventfs_error("open('%s') rc = %d\n", checkpoint_path, rc );
+      eventfs_safe_free( checkpoint_path );
+      return rc;
+   }
+   
+   dirents = fskit_listdir( eventfs->core, "/", 0, 0, &num_dirents, &rc );
+   if( dirents == NULL ) {
+      
+      close( fd );
+      unlink( checkpoint_path );
+      eventfs_safe_free( checkpoint_path );
+      return rc;
+   }
+   
+   for( uint64_t i = 0; i < num_dirents && rc == 0; i++ ) {
+      
+      if( dirents[i]->type != FSKIT_ENTRY_TYPE_DIR || strcmp( dirents[i]->name, "." ) == 0 || strcmp( dirents[i]->name, ".." ) == 0 ) {
+         continue;
+      }
+      
+      dir_path = fskit_fullpath( "/", dirents[i]->name, NULL );
+      if( dir_path == NULL ) {
+         
+         rc = -ENOMEM;
+         break;
+      }
+      
+      dent = fskit_entry_resolve_path( eventfs->core, dir_path, 0, 0, false, &rc );
+      if( dent == NULL ) {
+         
+         // raced with removal 
+         eventfs_safe_free( dir_path );
+         rc = 0;
+         continue;
+      }
+      
+      dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+      
+      sticky = (dir != NULL && fskit_fgetxattr( eventfs->core, dir_path, dent, "user.eventfs_sticky", NULL, 0 ) >= 0);
+      
+      if( dir == NULL || dir->deleted || (!sticky && !everything) ) {
+         
+         fskit_entry_unlock( dent );
+         eventfs_safe_free( dir_path );
+         continue;
+      }
+      
+      rc = eventfs_journal_write_dir( eventfs, fd, dir_path, dent, sticky ? NULL : eventfs_proc_get_pstat( dir->proc ) );
+      
+      if( !everything ) {
+         
+         // NOTE: nothing else is running yet, so a read lock suffices here
+         dir->journaled = true;
+      }
+      
+      for( struct eventfs_file_deque* itr = dir->head; itr != NULL && rc == 0; itr = itr->next ) {
+         
+         child = fskit_dir_find_by_name( dent, itr->name );
+         if( child == NULL ) {
+            continue;
+         }
+         
+         file_path = fskit_fullpath( dir_path, itr->name, NULL );
+         if( file_path == NULL ) {
+            
+            rc = -ENOMEM;
+            break;
+         }
+         
+         fskit_entry_rlock( child );
+         
+         inode = (struct eventfs_file_inode*)fskit_entry_get_user_data( child );
+         if( inode != NULL ) {
+            
+            rc = eventfs_journal_get_body( inode, &body, &body_len );
+         }
+         
+         if( rc == 0 ) {
+            rc = eventfs_journal_write( fd, EVENTFS_JOURNAL_APPEND, file_path, fskit_entry_get_mode( child ), fskit_entry_get_owner( child ), fskit_entry_get_group( child ), NULL, 0 );
+         }
+         
+         if( rc == 0 && body != NULL ) {
+            rc = eventfs_journal_write( fd, EVENTFS_JOURNAL_DATA, file_path, fskit_entry_get_mode( child ), fskit_entry_get_owner( child ), fskit_entry_get_group( child ), body, body_len );
+         }
+         
+         fskit_entry_unlock( child );
+         
+         eventfs_safe_free( body );
+         eventfs_safe_free( file_path );
+      }
+      
+      fskit_entry_unlock( dent );
+      eventfs_safe_free( dir_path );
+   }
+   
+   fskit_dir_entry_free_list( dirents );
+   
+   if( rc == 0 && fsync( fd ) != 0 ) {
+      rc = -errno;
+   }
+   
+   close( fd );
+   
+   if( rc == 0 && rename( checkpoint_path, path ) != 0 ) {
+      rc = -errno;
+   }
+   
+   if( rc != 0 ) {
+      
+      eventfs_error("Failed to write image to '%s', rc = %d\n", checkpoint_path, rc );
+      unlink( checkpoint_path );
+      eventfs_safe_free( checkpoint_path );
+      return rc;
+   }
+   
+   eventfs_safe_free( checkpoint_path );
+   
+   // make the rename durable 
+   journal_dir = fskit_dirname( path, NULL );
+   if( journal_dir != NULL ) {
+      
+      dir_fd = open( journal_dir, O_RDONLY );
+      if( dir_fd >= 0 ) {
+         
+         fsync( dir_fd );
+         close( dir_fd );
+      }
+      
+      eventfs_safe_free( journal_dir );
+   }
+   
+   return 0;
+}
+
+
+// write a fresh journal holding just the current state of every sticky directory, replace the old journal with it,
+// and start journaling to it.  This keeps the journal proportional to what is live.
+// call this before the filesystem is mounted.
+// return 0 on success 
+// return -ENOMEM on OOM 
+// return -errno on I/O error
+int eventfs_journal_checkpoint( struct eventfs_state* eventfs, char const* path ) {
+   
+   int rc = 0;
+   int fd = -1;
+   
+   rc = eventfs_journal_write_image( eventfs, path, false );
+   if( rc != 0 ) {
+      return rc;
+   }
+   
+   // start journaling 
+   fd = open( path, O_WRONLY | O_APPEND );
+   if( fd < 0 ) {
+      
+      rc = -errno;
+      eventfs_error("open('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+   
+   pthread_mutex_lock( &eventfs->journal.lock );
+   
+   eventfs->journal.fd = fd;
+   eventfs->journal.dirty = false;
+   
+   pthread_mutex_unlock( &eventfs->journal.lock );
+   
+   return 0;
+}
+
+
+// write a snapshot of every directory, its files, and their bodies to path, so a restarted eventfs can 
+// pick up where this one left off (see eventfs_journal_replay).  Usages are recomputed as it gets replayed.
+// call this after the filesystem is unmounted, but before the core is torn down.
+// return 0 on success 
+// return -ENOMEM on OOM 
+// return -errno on I/O error 
+int eventfs_journal_snapshot( struct eventfs_state* eventfs, char const* path ) {
+   
+   return eventfs_journal_write_image( eventfs, path, true );
+}
@@ -0,0 +1,81 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _EVENTFS_JOURNAL_H_
+#define _EVENTFS_JOURNAL_H_
+
+#include "os.h"
+#include "util.h"
+
+// journal record header magic ("EVJL")
+#define EVENTFS_JOURNAL_MAGIC           0x45564a4c
+
+// journal record types 
+#define EVENTFS_JOURNAL_DIR             1       // a sticky directory; data is its eventfs xattrs, as name\0value\0 pairs
+#define EVENTFS_JOURNAL_APPEND          2       // a file joined a directory's deque
+#define EVENTFS_JOURNAL_DATA            3       // a file's body; data is the whole body
+#define EVENTFS_JOURNAL_REMOVE          4       // a file left a directory
+#define EVENTFS_JOURNAL_RMDIR           5       // a directory was removed
+
+// suffix of the journal that a checkpoint is written to before it replaces the journal 
+#define EVENTFS_JOURNAL_CHECKPOINT_SUFFIX ".checkpoint"
+
+struct eventfs_state;
+struct eventfs_dir_inode;
+struct eventfs_file_inode;
+
+// on-disk record header.  Followed by path_len bytes of path, and data_len bytes of data.
+struct eventfs_journal_record {
+   
+   uint32_t magic;
+   uint32_t type;
+   uint32_t mode;
+   uint32_t owner;
+   uint32_t group;
+   uint32_t path_len;
+   uint64_t data_len;
+   uint32_t checksum;                   // FNV-1a over the path and data; detects a torn last record
+   uint32_t pid;                        // DIR records in a snapshot: the creator process (0 if the directory is sticky)
+   uint64_t starttime;                  // DIR records in a snapshot: the creator's start time
+};
+
+// append-only journal of changes to sticky directories 
+struct eventfs_journal {
+   
+   pthread_mutex_t lock;
+   int fd;                              // -1 if not journaling
+   bool dirty;                          // if true, then there are records that have not been fsync'ed
+};
+
+int eventfs_journal_init( struct eventfs_journal* journal );
+int eventfs_journal_close( struct eventfs_journal* journal );
+int eventfs_journal_sync( struct eventfs_journal* journal );
+
+int eventfs_journal_replay( struct eventfs_state* eventfs, char const* path );
+int eventfs_journal_checkpoint( struct eventfs_state* eventfs, char const* path );
+int eventfs_journal_snapshot( struct eventfs_state* eventfs, char const* path );
+
+int eventfs_journal_log_append( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* dent, struct eventfs_dir_inode* dir, struct fskit_entry* fent, char const* name, struct eventfs_file_inode* body );
+int eventfs_journal_log_data( struct eventfs_state* eventfs, char const* path, struct fskit_entry* fent );
+int eventfs_journal_log_remove( struct eventfs_state* eventfs, char const* path, struct eventfs_dir_inode* dir );
+int eventfs_journal_log_rmdir( struct eventfs_state* eventfs, char const* path, struct eventfs_dir_inode* dir );
+
+#endif
@@ -0,0 +1,203 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "lease.h"
+#include "eventfs.h"
+
+// get the lease length (in ticks) set on a directory 
+static uint64_t eventfs_lease_get_ticks( struct fskit_core* core, char const* path, struct fskit_entry* dent ) {
+   
+   int rc = 0;
+   char buf[EVENTFS_LEASE_BUF_LEN+1];
+   char* tmp = NULL;
+   uint64_t secs = EVENTFS_LEASE_DEFAULT_SECS;
+   
+   memset( buf, 0, EVENTFS_LEASE_BUF_LEN+1 );
+   
+   rc = fskit_fgetxattr( core, path, dent, EVENTFS_XATTR_LEASE, buf, EVENTFS_LEASE_BUF_LEN );
+   if( rc > 0 ) {
+      
+      secs = (uint64_t)strtoull( buf, &tmp, 10 );
+      if( tmp == buf || (*tmp != '\0' && *tmp != '\n') || secs == 0 ) {
+         
+         eventfs_error("Invalid %s '%s' on '%s'\n", EVENTFS_XATTR_LEASE, buf, path );
+         secs = EVENTFS_LEASE_DEFAULT_SECS;
+      }
+   }
+   
+   return (secs * 1000 + EVENTFS_TIMER_TICK_MS - 1) / EVENTFS_TIMER_TICK_MS;
+}
+
+
+// free a lease timer once the wheel is done with it
+static void eventfs_lease_free( struct eventfs_timer* timer, void* cls ) {
+   
+   struct eventfs_lease* lease = (struct eventfs_lease*)cls;
+   
+   eventfs_safe_free( lease->dir_path );
+   eventfs_safe_free( lease );
+}
+
+
+// reap the directory if its lease ran out, or wait for the renewed lease to run out.
+// runs on the deferred work queue, from the timer wheel.
+// return 0 on success, even if the directory is gone 
+static int eventfs_lease_expire( struct eventfs_timer* timer, void* cls ) {
+   
+   int rc = 0;
+   struct eventfs_lease* lease = (struct eventfs_lease*)cls;
+   struct eventfs_state* eventfs = lease->eventfs;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   uint64_t now = eventfs_timer_now();
+   uint64_t expires = 0;
+   
+   dent = fskit_entry_resolve_path( eventfs->core, lease->dir_path, 0, 0, true, &rc );
+   if( dent == NULL ) {
+      
+      // directory is gone; it will release this timer
+      return 0;
+   }
+   
+   dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   if( dir == NULL || dir != lease->dir || dir->lease != lease || dir->deleted ) {
+      
+      // not our directory anymore
+      fskit_entry_unlock( dent );
+      return 0;
+   }
+   
+   expires = __atomic_load_n( &dir->lease_expires, __ATOMIC_SEQ_CST );
+   if( now < expires ) {
+      
+      // renewed since we were scheduled
+      eventfs_timer_schedule( &eventfs->timers, timer, expires );
+      fskit_entry_unlock( dent );
+      return 0;
+   }
+   
+   rc = fskit_fgetxattr( eventfs->core, lease->dir_path, dent, "user.eventfs_sticky", NULL, 0 );
+   if( rc >= 0 ) {
+      
+      // sticky set 
+      fskit_entry_unlock( dent );
+      return 0;
+   }
+   
+   // owner stopped renewing; blow it away
+   eventfs_debug("lease on '%s' expired\n", lease->dir_path );
+   
+   dir->deleted = true;
+   
+   rc = eventfs_deferred_remove( eventfs, lease->dir_path, dent );
+   if( rc != 0 ) {
+      
+      eventfs_error("eventfs_deferred_remove('%s') rc = %d\n", lease->dir_path, rc );
+   }
+   
+   fskit_entry_unlock( dent );
+   return rc;
+}
+
+
+// put a directory into lease mode (if it isn't already), and renew its lease.
+// from then on, it lives for as long as its owner keeps renewing the lease, instead of sharing fate with its creator.
+// return 0 on success 
+// return -ENOMEM on OOM 
+// NOTE: dent must be write-locked
+int eventfs_lease_start( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* dent, struct eventfs_dir_inode* dir ) {
+   
+   struct eventfs_lease* lease = NULL;
+   
+   if( dir->lease != NULL ) {
+      
+      // pick up a new lease length, if it changed
+      __atomic_store_n( &dir->lease->ticks, eventfs_lease_get_ticks( eventfs->core, dir_path, dent ), __ATOMIC_SEQ_CST );
+      return eventfs_lease_renew( dir );
+   }
+   
+   lease = EVENTFS_CALLOC( struct eventfs_lease, 1 );
+   if( lease == NULL ) {
+      return -ENOMEM;
+   }
+   
+   lease->dir_path = strdup( dir_path );
+   if( lease->dir_path == NULL ) {
+      
+      eventfs_safe_free( lease );
+      return -ENOMEM;
+   }
+   
+   lease->eventfs = eventfs;
+   lease->dir = dir;
+   lease->ticks = eventfs_lease_get_ticks( eventfs->core, dir_path, dent );
+   eventfs_timer_init( &lease->timer, eventfs_lease_expire, eventfs_lease_free, lease );
+   
+   dir->lease = lease;
+   eventfs_lease_renew( dir );
+   
+   return eventfs_timer_schedule( &eventfs->timers, &lease->timer, dir->lease_expires );
+}
+
+
+// renew a directory's lease.
+// this only moves its expiry time, so it only needs the directory read-locked.
+// return 0 on success 
+// return -EINVAL if the directory is not in lease mode
+// NOTE: dir must be at least read-locked
+int eventfs_lease_renew( struct eventfs_dir_inode* dir ) {
+   
+   if( dir->lease == NULL ) {
+      return -EINVAL;
+   }
+   
+   uint64_t ticks = __atomic_load_n( &dir->lease->ticks, __ATOMIC_SEQ_CST );
+   
+   __atomic_store_n( &dir->lease_expires, eventfs_timer_now() + ticks, __ATOMIC_SEQ_CST );
+   return 0;
+}
+
+
+// is a leased directory's lease still good?
+bool eventfs_lease_is_live( struct eventfs_dir_inode* dir ) {
+   
+   return eventfs_timer_now() < __atomic_load_n( &dir->lease_expires, __ATOMIC_SEQ_CST );
+}
+
+
+// stop and release a directory's lease timer 
+// always succeeds
+// NOTE: the directory must be write-locked, or unreachable
+int eventfs_lease_release( struct eventfs_state* eventfs, struct eventfs_dir_inode* dir ) {
+   
+   if( dir->lease == NULL ) {
+      return 0;
+   }
+   
+   if( eventfs_timer_cancel( &eventfs->timers, &dir->lease->timer ) ) {
+      
+      eventfs_lease_free( &dir->lease->timer, dir->lease );
+   }
+   
+   // otherwise, it's firing, and will be freed once it's done
+   dir->lease = NULL;
+   return 0;
+}
@@ -0,0 +1,60 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _EVENTFS_LEASE_H_
+#define _EVENTFS_LEASE_H_
+
+#include "os.h"
+#include "util.h"
+#include "timer.h"
+
+// reserved name of the file a directory's owner touches to renew its lease
+#define EVENTFS_LEASE_NAME        ".lease"
+
+// xattr (on a directory) that gives the length of its lease, in seconds
+#define EVENTFS_XATTR_LEASE       "user.eventfs_lease"
+
+// lease length if the directory does not set one
+#define EVENTFS_LEASE_DEFAULT_SECS 30
+
+// longest lease value we parse
+#define EVENTFS_LEASE_BUF_LEN     32
+
+struct eventfs_state;
+struct eventfs_dir_inode;
+
+// a directory's lease timer.
+// renewing the lease only moves the directory's lease_expires; the timer notices when it fires, and waits some more.
+struct eventfs_lease {
+   
+   struct eventfs_timer timer;
+   struct eventfs_state* eventfs;
+   struct eventfs_dir_inode* dir;       // only compared against, never dereferenced without the directory locked
+   char* dir_path;
+   uint64_t ticks;                      // lease length (atomic; renewals read it with the directory only read-locked)
+};
+
+int eventfs_lease_start( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* dent, struct eventfs_dir_inode* dir );
+int eventfs_lease_renew( struct eventfs_dir_inode* dir );
+bool eventfs_lease_is_live( struct eventfs_dir_inode* dir );
+int eventfs_lease_release( struct eventfs_state* eventfs, struct eventfs_dir_inode* dir );
+
+#endif
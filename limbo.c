@@ -0,0 +1,135 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "limbo.h"
+#include "eventfs.h"
+
+// free everything waiting in limbo right now.
+// inodes added while this runs wait for the next drain.
+// always succeeds
+void eventfs_limbo_drain( struct eventfs_limbo* limbo ) {
+   
+   struct eventfs_file_inode* inode = NULL;
+   struct eventfs_file_inode* next = NULL;
+   int count = 0;
+   uint64_t bytes = 0;
+   
+   // take the whole list; nobody else removes from it, so there is no ABA to worry about
+   inode = __atomic_exchange_n( &limbo->head, NULL, __ATOMIC_SEQ_CST );
+   
+   for( ; inode != NULL; inode = next ) {
+      
+      next = inode->limbo_next;
+      
+      count++;
+      bytes += inode->size;
+      
+      eventfs_file_inode_free( inode );
+      eventfs_safe_free( inode );
+   }
+   
+   if( count > 0 ) {
+      
+      __atomic_sub_fetch( &limbo->count, count, __ATOMIC_SEQ_CST );
+      __atomic_sub_fetch( &limbo->bytes, bytes, __ATOMIC_SEQ_CST );
+      
+      eventfs_debug("DEFERRED: free %d bodies (%" PRIu64 " bytes)\n", count, bytes );
+   }
+}
+
+
+// work queue callback to drain limbo early, once a lot has piled up 
+static int eventfs_limbo_drain_cb( struct eventfs_wreq* wreq, void* cls ) {
+   
+   struct eventfs_limbo* limbo = (struct eventfs_limbo*)cls;
+   
+   __atomic_store_n( &limbo->drain_queued, false, __ATOMIC_SEQ_CST );
+   eventfs_limbo_drain( limbo );
+   return 0;
+}
+
+
+// free a message's inode and body off of the calling thread.
+// the inode goes on the shared limbo list, which deferred_wq drains every tick (or sooner, if a lot piles up),
+// so no lock needs to be held while the body is freed.
+// bodies small enough to be inline are freed right away, since that's as cheap as deferring them.
+// once deferred_wq is stopped, everything is freed right away.
+// always succeeds
+void eventfs_limbo_add( struct eventfs_state* eventfs, struct eventfs_file_inode* inode ) {
+   
+   struct eventfs_limbo* limbo = &eventfs->limbo;
+   struct eventfs_wreq* work = NULL;
+   uint64_t count = 0;
+   uint64_t bytes = 0;
+   
+   if( inode->chunks == NULL || __atomic_load_n( &limbo->stopped, __ATOMIC_SEQ_CST ) ) {
+      
+      // inline, or nobody left to free it for us 
+      eventfs_file_inode_free( inode );
+      eventfs_safe_free( inode );
+      return;
+   }
+   
+   count = __atomic_add_fetch( &limbo->count, 1, __ATOMIC_SEQ_CST );
+   bytes = __atomic_add_fetch( &limbo->bytes, (uint64_t)inode->size, __ATOMIC_SEQ_CST );
+   
+   inode->limbo_next = __atomic_load_n( &limbo->head, __ATOMIC_SEQ_CST );
+   while( !__atomic_compare_exchange_n( &limbo->head, &inode->limbo_next, inode, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) );
+   
+   if( __atomic_load_n( &limbo->stopped, __ATOMIC_SEQ_CST ) ) {
+      
+      // stopped while we were adding it; don't leave it behind
+      eventfs_limbo_drain( limbo );
+      return;
+   }
+   
+   if( count < EVENTFS_LIMBO_BATCH && bytes < EVENTFS_LIMBO_BATCH_BYTES ) {
+      
+      // the next tick gets it
+      return;
+   }
+   
+   if( __atomic_exchange_n( &limbo->drain_queued, true, __ATOMIC_SEQ_CST ) ) {
+      
+      // already coming
+      return;
+   }
+   
+   work = EVENTFS_CALLOC( struct eventfs_wreq, 1 );
+   if( work == NULL ) {
+      
+      // the next tick gets it
+      __atomic_store_n( &limbo->drain_queued, false, __ATOMIC_SEQ_CST );
+      return;
+   }
+   
+   eventfs_wreq_init( work, eventfs_limbo_drain_cb, limbo );
+   eventfs_wq_add( eventfs->deferred_wq, work );
+}
+
+
+// deferred_wq has stopped: free whatever is waiting, and free everything from now on as it is added.
+// always succeeds
+void eventfs_limbo_stop( struct eventfs_limbo* limbo ) {
+   
+   __atomic_store_n( &limbo->stopped, true, __ATOMIC_SEQ_CST );
+   eventfs_limbo_drain( limbo );
+}
@@ -0,0 +1,50 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _EVENTFS_LIMBO_H_
+#define _EVENTFS_LIMBO_H_
+
+#include "os.h"
+#include "util.h"
+#include "inode.h"
+
+// freed message bodies are drained every timer tick, or sooner once this many, or this many bytes of them, are waiting
+#define EVENTFS_LIMBO_BATCH             64
+#define EVENTFS_LIMBO_BATCH_BYTES       (1024 * 1024)
+
+struct eventfs_state;
+
+// message bodies that have been let go of, waiting to be freed in the background.
+// one lock-free list shared by every thread; deferred_wq takes the whole list at once.
+struct eventfs_limbo {
+   
+   struct eventfs_file_inode* head;     // most recently added inode (atomic)
+   uint64_t count;                      // inodes waiting (atomic)
+   uint64_t bytes;                      // bytes of bodies waiting (atomic)
+   bool drain_queued;                   // if true, then an early drain is on deferred_wq (atomic)
+   bool stopped;                        // if true, then deferred_wq is stopped, and bodies are freed on the spot (atomic)
+};
+
+void eventfs_limbo_add( struct eventfs_state* eventfs, struct eventfs_file_inode* inode );
+void eventfs_limbo_drain( struct eventfs_limbo* limbo );
+void eventfs_limbo_stop( struct eventfs_limbo* limbo );
+
+#endif
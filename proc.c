@@ -0,0 +1,474 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "proc.h"
+#include "inode.h"
+#include "timer.h"
+
+SGLIB_DEFINE_RBTREE_FUNCTIONS( eventfs_proc, left, right, color, EVENTFS_PROC_CMP );
+
+// one stripe of the process table.
+// all of a pid's entries share a stripe, so unrelated processes don't contend.
+struct eventfs_proc_bucket {
+   
+   pthread_mutex_t lock;
+   eventfs_proc* procs;
+};
+
+// all processes that own at least one directory
+static struct eventfs_proc_bucket g_procs[ EVENTFS_PROC_BUCKETS ];
+static pthread_once_t g_procs_once = PTHREAD_ONCE_INIT;
+
+
+// set up the process table
+static void eventfs_proc_table_init( void ) {
+   
+   for( int i = 0; i < EVENTFS_PROC_BUCKETS; i++ ) {
+      
+      pthread_mutex_init( &g_procs[i].lock, NULL );
+      g_procs[i].procs = NULL;
+   }
+}
+
+
+// get the stripe that holds a pid's entries
+static struct eventfs_proc_bucket* eventfs_proc_bucket( pid_t pid ) {
+   
+   pthread_once( &g_procs_once, eventfs_proc_table_init );
+   return &g_procs[ (uint32_t)pid % EVENTFS_PROC_BUCKETS ];
+}
+
+
+// look up the process identified by pid, and take a reference to it.
+// a process we have not seen before (or a new process reusing an old pid) gets a new entry.
+// return the entry on success, with *rc set to 0
+// return NULL with *rc set to -ENOMEM on OOM 
+// return NULL with *rc set to negative on failure to stat the process
+eventfs_proc* eventfs_proc_get( pid_t pid, int* rc ) {
+   
+   eventfs_proc* member = NULL;
+   eventfs_proc lookup;
+   struct eventfs_proc_bucket* bucket = eventfs_proc_bucket( pid );
+   
+   struct pstat* ps = pstat_new();
+   if( ps == NULL ) {
+      
+      *rc = -ENOMEM;
+      return NULL;
+   }
+   
+   *rc = pstat( pid, ps, 0 );
+   if( *rc != 0 ) {
+      
+      pstat_free( ps );
+      return NULL;
+   }
+   
+   memset( &lookup, 0, sizeof(eventfs_proc) );
+   lookup.pid = pid;
+   lookup.starttime = pstat_get_starttime( ps );
+   
+   pthread_mutex_lock( &bucket->lock );
+   
+   member = sglib_eventfs_proc_find_member( bucket->procs, &lookup );
+   if( member != NULL ) {
+      
+      // another of this process's directories got here first
+      member->refcount++;
+      pthread_mutex_unlock( &bucket->lock );
+      
+      pstat_free( ps );
+      return member;
+   }
+   
+   member = EVENTFS_CALLOC( eventfs_proc, 1 );
+   if( member == NULL ) {
+      
+      pthread_mutex_unlock( &bucket->lock );
+      
+      pstat_free( ps );
+      *rc = -ENOMEM;
+      return NULL;
+   }
+   
+   pthread_mutex_init( &member->lock, NULL );
+   member->pid = pid;
+   member->starttime = lookup.starttime;
+   member->ps = ps;
+   member->refcount = 1;
+   
+   sglib_eventfs_proc_add( &bucket->procs, member );
+   
+   pthread_mutex_unlock( &bucket->lock );
+   return member;
+}
+
+
+// release a reference to a process, and forget it once no directory points to it
+void eventfs_proc_put( eventfs_proc* proc ) {
+   
+   struct eventfs_proc_bucket* bucket = eventfs_proc_bucket( proc->pid );
+   
+   pthread_mutex_lock( &bucket->lock );
+   
+   proc->refcount--;
+   if( proc->refcount > 0 ) {
+      
+      pthread_mutex_unlock( &bucket->lock );
+      return;
+   }
+   
+   sglib_eventfs_proc_delete( &bucket->procs, proc );
+   
+   pthread_mutex_unlock( &bucket->lock );
+   
+   if( proc->current != NULL ) {
+      
+      pstat_free( proc->current );
+      proc->current = NULL;
+   }
+   
+   pstat_free( proc->ps );
+   pthread_mutex_destroy( &proc->lock );
+   
+   eventfs_safe_free( proc );
+}
+
+
+// index a directory under the process that created it, so it can be found once the process exits
+// always succeeds
+// NOTE: dir->path must be set, and dir must not already be indexed
+int eventfs_proc_add_dir( eventfs_proc* proc, struct eventfs_dir_inode* dir ) {
+   
+   struct eventfs_proc_bucket* bucket = eventfs_proc_bucket( proc->pid );
+   
+   pthread_mutex_lock( &bucket->lock );
+   
+   dir->proc_prev = NULL;
+   dir->proc_next = proc->dirs;
+   
+   if( proc->dirs != NULL ) {
+      proc->dirs->proc_prev = dir;
+   }
+   
+   proc->dirs = dir;
+   dir->proc_indexed = true;
+   
+   pthread_mutex_unlock( &bucket->lock );
+   return 0;
+}
+
+
+// remove a directory from its creator's index, if it is in it
+// always succeeds
+int eventfs_proc_remove_dir( eventfs_proc* proc, struct eventfs_dir_inode* dir ) {
+   
+   struct eventfs_proc_bucket* bucket = eventfs_proc_bucket( proc->pid );
+   
+   pthread_mutex_lock( &bucket->lock );
+   
+   if( dir->proc_indexed ) {
+      
+      if( dir->proc_prev != NULL ) {
+         dir->proc_prev->proc_next = dir->proc_next;
+      }
+      else {
+         proc->dirs = dir->proc_next;
+      }
+      
+      if( dir->proc_next != NULL ) {
+         dir->proc_next->proc_prev = dir->proc_prev;
+      }
+      
+      dir->proc_prev = NULL;
+      dir->proc_next = NULL;
+      dir->proc_indexed = false;
+   }
+   
+   pthread_mutex_unlock( &bucket->lock );
+   return 0;
+}
+
+
+// get the process's status as of when it was first seen
+struct pstat* eventfs_proc_get_pstat( eventfs_proc* proc ) {
+   
+   return proc->ps;
+}
+
+
+// get the process's current status, re-reading it from /proc at most once every EVENTFS_PROC_CHECK_TICKS ticks,
+// however many of its directories ask.
+// on success, proc is locked, and *current is valid until eventfs_proc_unlock()
+// return 0 on success
+// return -ENOMEM on OOM 
+// return negative on failure to stat the process
+int eventfs_proc_lock_current( eventfs_proc* proc, struct pstat** current ) {
+   
+   int rc = 0;
+   uint64_t now = eventfs_timer_now();
+   
+   pthread_mutex_lock( &proc->lock );
+   
+   if( proc->current == NULL || proc->checked + EVENTFS_PROC_CHECK_TICKS <= now ) {
+      
+      struct pstat* ps = pstat_new();
+      if( ps == NULL ) {
+         
+         pthread_mutex_unlock( &proc->lock );
+         return -ENOMEM;
+      }
+      
+      rc = pstat( proc->pid, ps, 0 );
+      if( rc < 0 ) {
+         
+         pthread_mutex_unlock( &proc->lock );
+         
+         pstat_free( ps );
+         return rc;
+      }
+      
+      if( proc->current != NULL ) {
+         pstat_free( proc->current );
+      }
+      
+      proc->current = ps;
+      proc->checked = now;
+   }
+   
+   *current = proc->current;
+   return 0;
+}
+
+
+// release a process locked by eventfs_proc_lock_current()
+void eventfs_proc_unlock( eventfs_proc* proc ) {
+   
+   pthread_mutex_unlock( &proc->lock );
+}
+
+
+// read a process's start time (field 22 of /proc/<pid>/stat), with one pread into a stack buffer.
+// return 0 on success, and set *starttime
+// return -ESRCH if there is no such process, or it is a zombie
+// return -EIO if the stat line can't be parsed 
+// return -errno on failure to read it
+int eventfs_proc_read_starttime( pid_t pid, uint64_t* starttime ) {
+   
+   int rc = 0;
+   int fd = 0;
+   ssize_t nr = 0;
+   char* p = NULL;
+   char* end = NULL;
+   char path[EVENTFS_PROC_PATH_LEN+1];
+   char buf[EVENTFS_PROC_STAT_BUF_LEN+1];
+   
+   snprintf( path, EVENTFS_PROC_PATH_LEN, "/proc/%d/stat", (int)pid );
+   
+   fd = open( path, O_RDONLY | O_CLOEXEC );
+   if( fd < 0 ) {
+      
+      rc = -errno;
+      return (rc == -ENOENT ? -ESRCH : rc);
+   }
+   
+   nr = pread( fd, buf, EVENTFS_PROC_STAT_BUF_LEN, 0 );
+   rc = -errno;
+   
+   close( fd );
+   
+   if( nr < 0 ) {
+      return (rc == -ESRCH ? -ESRCH : rc);
+   }
+   
+   buf[nr] = '\0';
+   
+   // the command name (field 2) is parenthesized, and may itself contain spaces and parentheses
+   p = strrchr( buf, ')' );
+   if( p == NULL || p[1] != ' ' ) {
+      return -EIO;
+   }
+   
+   if( p[2] == 'Z' ) {
+      
+      // exited, but not yet reaped
+      return -ESRCH;
+   }
+   
+   // the i-th space after the command name precedes field i + 2
+   for( int i = 0; i < 20; i++ ) {
+      
+      p = strchr( p + 1, ' ' );
+      if( p == NULL ) {
+         return -EIO;
+      }
+   }
+   
+   errno = 0;
+   *starttime = strtoull( p + 1, &end, 10 );
+   if( end == p + 1 || errno != 0 ) {
+      return -EIO;
+   }
+   
+   return 0;
+}
+
+
+// is a process still the one we first saw?  Only compares start times, so this skips libpstat
+// (no stat of the binary, no path resolution).  Re-read at most once every EVENTFS_PROC_CHECK_TICKS ticks.
+// return 1 if so 
+// return 0 if not
+// return negative on error
+int eventfs_proc_is_alive( eventfs_proc* proc ) {
+   
+   int rc = 0;
+   uint64_t starttime = 0;
+   uint64_t now = eventfs_timer_now();
+   
+   pthread_mutex_lock( &proc->lock );
+   
+   if( proc->alive_checked == 0 || proc->alive_checked + EVENTFS_PROC_CHECK_TICKS <= now ) {
+      
+      rc = eventfs_proc_read_starttime( proc->pid, &starttime );
+      if( rc == -ESRCH ) {
+         
+         proc->alive = 0;
+      }
+      else if( rc < 0 ) {
+         
+         pthread_mutex_unlock( &proc->lock );
+         return rc;
+      }
+      else {
+         
+         proc->alive = (starttime == proc->starttime ? 1 : 0);
+      }
+      
+      proc->alive_checked = (now > 0 ? now : 1);
+   }
+   
+   rc = proc->alive;
+   
+   pthread_mutex_unlock( &proc->lock );
+   return rc;
+}
+
+
+// order process entries by pid alone, to find all of the entries for one pid
+static int eventfs_proc_pid_cmp( eventfs_proc* p1, eventfs_proc* p2 ) {
+   
+   return (p1->pid < p2->pid ? -1 : (p1->pid > p2->pid ? 1 : 0));
+}
+
+
+// note that the process with the given pid exited at timestamp_ns (CLOCK_BOOTTIME nanoseconds, like process start times).
+// every entry for that pid that started before then is marked as exited, so checking its directories is free.
+// an entry that started afterwards belongs to a new process that reused the pid, and is left alone.
+// if any were marked, *dir_paths is set to a NULL-terminated, malloc'ed list of the paths of their directories
+// (or NULL on OOM, in which case the caller should sweep).
+// return the number of entries marked
+int eventfs_proc_exited( pid_t pid, uint64_t timestamp_ns, char*** dir_paths ) {
+   
+   int count = 0;
+   size_t num_dirs = 0;
+   size_t i = 0;
+   char** paths = NULL;
+   eventfs_proc* itr = NULL;
+   eventfs_proc lookup;
+   struct sglib_eventfs_proc_iterator it;
+   struct eventfs_proc_bucket* bucket = eventfs_proc_bucket( pid );
+   long clk_tck = sysconf( _SC_CLK_TCK );
+   
+   *dir_paths = NULL;
+   
+   memset( &lookup, 0, sizeof(eventfs_proc) );
+   lookup.pid = pid;
+   
+   pthread_mutex_lock( &bucket->lock );
+   
+   for( itr = sglib_eventfs_proc_it_init_on_equal( &it, bucket->procs, eventfs_proc_pid_cmp, &lookup ); itr != NULL; itr = sglib_eventfs_proc_it_next( &it ) ) {
+      
+      // start time is in clock ticks since boot, counting time spent suspended
+      if( clk_tck > 0 && itr->starttime * (1000000000ULL / (uint64_t)clk_tck) > timestamp_ns ) {
+         continue;
+      }
+      
+      pthread_mutex_lock( &itr->lock );
+      itr->exited = true;
+      pthread_mutex_unlock( &itr->lock );
+      
+      for( struct eventfs_dir_inode* dir = itr->dirs; dir != NULL; dir = dir->proc_next ) {
+         num_dirs++;
+      }
+      
+      count++;
+   }
+   
+   if( count > 0 ) {
+      
+      paths = EVENTFS_CALLOC( char*, num_dirs + 1 );
+   }
+   
+   if( paths != NULL ) {
+      
+      for( itr = sglib_eventfs_proc_it_init_on_equal( &it, bucket->procs, eventfs_proc_pid_cmp, &lookup ); itr != NULL && paths != NULL; itr = sglib_eventfs_proc_it_next( &it ) ) {
+         
+         if( !itr->exited ) {
+            continue;
+         }
+         
+         for( struct eventfs_dir_inode* dir = itr->dirs; dir != NULL && i < num_dirs; dir = dir->proc_next ) {
+            
+            paths[i] = strdup( dir->path );
+            if( paths[i] == NULL ) {
+               
+               // OOM
+               for( size_t j = 0; j < i; j++ ) {
+                  eventfs_safe_free( paths[j] );
+               }
+               
+               eventfs_safe_free( paths );
+               break;
+            }
+            
+            i++;
+         }
+      }
+   }
+   
+   pthread_mutex_unlock( &bucket->lock );
+   
+   *dir_paths = paths;
+   return count;
+}
+
+
+// were we told that this process exited?
+bool eventfs_proc_has_exited( eventfs_proc* proc ) {
+   
+   bool exited = false;
+   
+   pthread_mutex_lock( &proc->lock );
+   exited = proc->exited;
+   pthread_mutex_unlock( &proc->lock );
+   
+   return exited;
+}
@@ -0,0 +1,89 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _EVENTFS_PROC_H_
+#define _EVENTFS_PROC_H_
+
+#include "os.h"
+#include "util.h"
+#include "sglib.h"
+
+#include <pstat/libpstat.h>
+
+struct eventfs_dir_inode;
+
+// number of stripes in the process table
+#define EVENTFS_PROC_BUCKETS     64
+
+// a process's current status is re-read from /proc at most once every this many timer ticks
+#define EVENTFS_PROC_CHECK_TICKS 1
+
+// enough of /proc/<pid>/stat to reach the start time (field 22), even with a maximal command name
+#define EVENTFS_PROC_STAT_BUF_LEN 1024
+#define EVENTFS_PROC_PATH_LEN     32
+
+// identity of a process that created one or more directories.
+// there is one of these per (pid, starttime), shared by all of that process's directories.
+struct eventfs_proc_entry {
+   
+   pid_t pid;
+   uint64_t starttime;
+   struct pstat* ps;                    // status when the process was first seen (never changes)
+   int refcount;                        // number of directories pointing here (guarded by the bucket lock)
+   struct eventfs_dir_inode* dirs;      // directories it created (guarded by the bucket lock)
+   
+   pthread_mutex_t lock;                // guards current and checked
+   struct pstat* current;               // status as of the last check (NULL until the first one)
+   uint64_t checked;                    // timer tick of the last check
+   
+   int alive;                           // result of the last start-time-only check (guarded by lock)
+   uint64_t alive_checked;              // timer tick of the last start-time-only check (0 if never)
+   bool exited;                         // if true, then we were told the process exited (guarded by lock)
+   
+   // rb tree 
+   int color;
+   struct eventfs_proc_entry* left;
+   struct eventfs_proc_entry* right;
+};
+
+typedef struct eventfs_proc_entry eventfs_proc;
+
+#define EVENTFS_PROC_CMP( p1, p2 ) ((p1)->pid != (p2)->pid ? ((p1)->pid < (p2)->pid ? -1 : 1) : ((p1)->starttime < (p2)->starttime ? -1 : ((p1)->starttime > (p2)->starttime ? 1 : 0)))
+
+SGLIB_DEFINE_RBTREE_PROTOTYPES( eventfs_proc, left, right, color, EVENTFS_PROC_CMP );
+
+eventfs_proc* eventfs_proc_get( pid_t pid, int* rc );
+void eventfs_proc_put( eventfs_proc* proc );
+
+struct pstat* eventfs_proc_get_pstat( eventfs_proc* proc );
+int eventfs_proc_lock_current( eventfs_proc* proc, struct pstat** current );
+void eventfs_proc_unlock( eventfs_proc* proc );
+
+int eventfs_proc_read_starttime( pid_t pid, uint64_t* starttime );
+int eventfs_proc_is_alive( eventfs_proc* proc );
+
+int eventfs_proc_add_dir( eventfs_proc* proc, struct eventfs_dir_inode* dir );
+int eventfs_proc_remove_dir( eventfs_proc* proc, struct eventfs_dir_inode* dir );
+
+int eventfs_proc_exited( pid_t pid, uint64_t timestamp_ns, char*** dir_paths );
+bool eventfs_proc_has_exited( eventfs_proc* proc );
+
+#endif
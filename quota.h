@@ -25,6 +25,8 @@
 #include "os.h"
 #include "sglib.h"
 
+struct eventfs_dir_inode;
+
 // quota for a user or group
 struct eventfs_quota_entry {
     
@@ -55,6 +57,9 @@ struct eventfs_usage_entry {
     uint64_t num_dirs;
     uint64_t num_bytes;
     
+    // directories this user created, newest first (users only; guarded by the owner lock)
+    struct eventfs_dir_inode* dirs;
+    
     // rb tree 
     int color;
     struct eventfs_usage_entry* left;
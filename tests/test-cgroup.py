@@ -0,0 +1,85 @@
+#!/usr/bin/python
+
+# Directories share fate with their creator's cgroup, even when a cgroup of the same name is refilled or recreated.
+#
+# Run eventfs with `fate=cgroup`, as a user that can create cgroups under CGROUP_PARENT (e.g. a delegated
+# subtree of /sys/fs/cgroup), then:
+#   test-cgroup.py MOUNTPOINT CGROUP_PARENT
+
+import os
+import sys
+import time
+import signal
+
+TIMEOUT = 10
+
+if len(sys.argv) < 3 or not os.path.exists( sys.argv[1] ) or not os.path.isdir( sys.argv[2] ):
+    print >> sys.stderr, "Usage: %s MOUNTPOINT CGROUP_PARENT" % sys.argv[0]
+    sys.exit(1)
+
+mountpoint = sys.argv[1]
+cgroup = "%s/test-cgroup" % sys.argv[2]
+
+# fork a child into the cgroup, and have it create a directory and wait
+def spawn( name ):
+    r, w = os.pipe()
+    pid = os.fork()
+    if pid == 0:
+        os.close(r)
+        with open("%s/cgroup.procs" % cgroup, "w") as f:
+            f.write("%s\n" % os.getpid())
+
+        os.mkdir( "%s/%s" % (mountpoint, name) )
+        os.write( w, "x" )
+        while True:
+            time.sleep(100)
+
+    os.close(w)
+    os.read( r, 1 )
+    os.close(r)
+    return pid
+
+def wait_gone( name ):
+    deadline = time.time() + TIMEOUT
+    while time.time() < deadline:
+        if not os.path.exists( "%s/%s" % (mountpoint, name) ):
+            return True
+
+        time.sleep(0.1)
+
+    return False
+
+def check_round( name ):
+
+    pid = spawn( name )
+    print "%s created by %s in %s" % (name, pid, cgroup)
+
+    # must outlive its creation while the cgroup is populated
+    time.sleep(2)
+    if not os.path.exists( "%s/%s" % (mountpoint, name) ):
+        print >> sys.stderr, "%s disappeared while its cgroup was populated" % name
+        sys.exit(1)
+
+    os.kill( pid, signal.SIGKILL )
+    os.waitpid( pid, 0 )
+
+    if not wait_gone( name ):
+        print >> sys.stderr, "%s still exists %s seconds after its cgroup emptied" % (name, TIMEOUT)
+        sys.exit(1)
+
+    print "%s removed once %s emptied" % (name, cgroup)
+
+if not os.path.exists( cgroup ):
+    os.mkdir( cgroup )
+
+# first use, then refill the same cgroup
+check_round( "test-cgroup-0" )
+check_round( "test-cgroup-1" )
+
+# recreate it under the same name
+os.rmdir( cgroup )
+os.mkdir( cgroup )
+check_round( "test-cgroup-2" )
+
+os.rmdir( cgroup )
+print "OK"
@@ -0,0 +1,47 @@
+#!/usr/bin/python
+
+import os
+import sys
+import time
+
+NUM_CURSORS = 2
+NUM_FILES = 10
+
+mountpoint = sys.argv[1]
+if not os.path.exists( mountpoint ):
+    print >> sys.stderr, "Usage: %s MOUNTPOINT" % sys.argv[0]
+    sys.exit(1)
+
+queue = "%s/test-cursors" % mountpoint
+print "event queue: %s" % queue
+os.mkdir( queue )
+
+for i in xrange(0, NUM_CURSORS):
+    print "cursor: %s/.cursor.%s" % (queue, i)
+    with open("%s/.cursor.%s" % (queue, i), "w") as f:
+        pass
+
+for j in xrange(0, NUM_FILES):
+    path = "%s/%s" % (queue, j)
+    print "event message: %s" % path
+
+    with open(path, "w+") as f:
+        f.write("%s\n" % j)
+
+for i in xrange(0, NUM_CURSORS):
+    cursor = "%s/.cursor.%s" % (queue, i)
+
+    # consume all but the last message through this cursor
+    for j in xrange(0, NUM_FILES - 1 - i):
+        with open(cursor, "r") as f:
+            name = f.read().strip()
+
+        print "cursor %s: %s" % (i, name)
+        with open(cursor, "w") as f:
+            f.write("%s\n" % name)
+
+print "remaining: %s" % sorted(os.listdir( queue ))
+
+print "Waiting for SIGINT"
+while True:
+    time.sleep(100)
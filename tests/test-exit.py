@@ -0,0 +1,132 @@
+#!/usr/bin/python
+
+# Directories go away when their creator exits.
+#
+# Each child process creates a directory and exits right away.  With the process connector,
+# eventfs hears about each exit and removes its directories without a sweep.  Spawning a burst of
+# children at once overruns the connector socket (ENOBUFS), which makes eventfs fall back to a sweep;
+# either way, every directory must be gone shortly afterwards.
+
+import os
+import sys
+import time
+import errno
+
+NUM_SERIAL = 10
+NUM_BURST = 2000
+NUM_FILES = 5000
+TIMEOUT = 10
+
+if len(sys.argv) < 2 or not os.path.exists( sys.argv[1] ):
+    print >> sys.stderr, "Usage: %s MOUNTPOINT" % sys.argv[0]
+    sys.exit(1)
+
+mountpoint = sys.argv[1]
+
+def spawn( name ):
+    pid = os.fork()
+    if pid == 0:
+        try:
+            os.mkdir( "%s/%s" % (mountpoint, name) )
+            os._exit(0)
+        except:
+            os._exit(1)
+
+    return pid
+
+def wait_gone( names ):
+    deadline = time.time() + TIMEOUT
+    left = names
+    while time.time() < deadline:
+        left = [n for n in left if os.path.exists( "%s/%s" % (mountpoint, n) )]
+        if len(left) == 0:
+            return []
+
+        time.sleep(0.1)
+
+    return left
+
+# one at a time
+names = []
+for i in xrange(0, NUM_SERIAL):
+    name = "test-exit-%s" % i
+    pid = spawn( name )
+    os.waitpid( pid, 0 )
+    names.append( name )
+
+    start = time.time()
+    left = wait_gone( [name] )
+    if len(left) > 0:
+        print >> sys.stderr, "%s still exists after %s seconds" % (name, TIMEOUT)
+        sys.exit(1)
+
+    print "%s removed after %.3f seconds" % (name, time.time() - start)
+
+# all at once
+names = []
+pids = []
+for i in xrange(0, NUM_BURST):
+    name = "test-exit-burst-%s" % i
+    pids.append( spawn( name ) )
+    names.append( name )
+
+for pid in pids:
+    os.waitpid( pid, 0 )
+
+start = time.time()
+left = wait_gone( names )
+if len(left) > 0:
+    print >> sys.stderr, "%s of %s directories still exist after %s seconds" % (len(left), NUM_BURST, TIMEOUT)
+    sys.exit(1)
+
+print "%s directories removed after %.3f seconds" % (NUM_BURST, time.time() - start)
+
+# a big dead queue is drained in the background, but its name is free as soon as it is gone
+name = "test-exit-big"
+pid = os.fork()
+if pid == 0:
+    path = "%s/%s" % (mountpoint, name)
+    os.mkdir( path )
+    for i in xrange(0, NUM_FILES):
+        with open("%s/%s" % (path, i), "w") as f:
+            f.write("%s\n" % i)
+
+    os._exit(0)
+
+os.waitpid( pid, 0 )
+
+left = wait_gone( [name] )
+if len(left) > 0:
+    print >> sys.stderr, "%s still exists after %s seconds" % (name, TIMEOUT)
+    sys.exit(1)
+
+# it is moved out of the way by the first piece of deferred work, so its name may be busy for a moment
+path = "%s/%s" % (mountpoint, name)
+deadline = time.time() + TIMEOUT
+while True:
+    try:
+        os.mkdir( path )
+        break
+    except OSError as e:
+        if e.errno != errno.EEXIST or time.time() >= deadline:
+            raise
+
+        time.sleep(0.01)
+
+if len(os.listdir( path )) != 0:
+    print >> sys.stderr, "%s was recreated with the dead directory's files in it" % name
+    sys.exit(1)
+
+os.rmdir( path )
+print "%s recreated while its %s files were being drained" % (name, NUM_FILES)
+
+# the names dead directories are drained under are reserved
+try:
+    os.mkdir( "%s/.reaped.1" % mountpoint )
+    print >> sys.stderr, "created a directory with a reserved name"
+    sys.exit(1)
+except OSError as e:
+    if e.errno != errno.EPERM:
+        raise
+
+print "OK"
@@ -0,0 +1,112 @@
+#!/usr/bin/python
+
+# Restart round-trip for the journal.
+#
+# Run eventfs with a `journal` file configured, then:
+#   test-journal.py MOUNTPOINT write          (writes a sticky queue)
+#   (stop eventfs)
+#   test-journal.py MOUNTPOINT tear JOURNAL   (optional: chop the last record in half)
+#   (start eventfs again)
+#   test-journal.py MOUNTPOINT check [torn]   (verifies the queue was replayed)
+
+import os
+import sys
+import time
+import subprocess
+
+NUM_FILES = 10
+
+def usage():
+    print >> sys.stderr, "Usage: %s MOUNTPOINT write|check [torn]|tear JOURNAL" % sys.argv[0]
+    sys.exit(1)
+
+if len(sys.argv) < 3:
+    usage()
+
+mountpoint = sys.argv[1]
+mode = sys.argv[2]
+queue = "%s/test-journal" % mountpoint
+
+if mode == "write":
+
+    if not os.path.exists( mountpoint ):
+        usage()
+
+    print "event queue: %s" % queue
+    os.mkdir( queue )
+    subprocess.check_call( ["setfattr", "-n", "user.eventfs_sticky", "-v", "1", queue] )
+
+    for j in xrange(0, NUM_FILES):
+        path = "%s/.push" % queue
+        print "event message: %s" % path
+
+        with open(path, "w") as f:
+            f.write("%s\n" % j)
+
+    print "head -> %s" % os.readlink( "%s/head" % queue )
+    print "tail -> %s" % os.readlink( "%s/tail" % queue )
+
+    # journal is flushed about once a second
+    time.sleep(3)
+    print "Now restart eventfs and run '%s %s check'" % (sys.argv[0], mountpoint)
+
+elif mode == "tear":
+
+    if len(sys.argv) < 4:
+        usage()
+
+    # eventfs must not be running; drop the back half of the last record
+    journal = sys.argv[3]
+    size = os.path.getsize( journal )
+    if size == 0:
+        print >> sys.stderr, "%s is empty" % journal
+        sys.exit(1)
+
+    with open(journal, "r+") as f:
+        f.truncate( size - 8 )
+
+    print "truncated %s from %s to %s bytes" % (journal, size, size - 8)
+
+    if os.path.exists( journal + ".checkpoint" ):
+        print >> sys.stderr, "leftover checkpoint %s.checkpoint" % journal
+        sys.exit(1)
+
+elif mode == "check":
+
+    # with a torn tail, the last message may be lost but nothing before it
+    torn = (len(sys.argv) > 3 and sys.argv[3] == "torn")
+    expected = NUM_FILES
+    if torn:
+        expected = NUM_FILES - 1
+
+    if not os.path.isdir( queue ):
+        print >> sys.stderr, "%s was not replayed" % queue
+        sys.exit(1)
+
+    names = [n for n in os.listdir( queue ) if n not in ["head", "tail", ".push", ".lease"]]
+    names.sort()
+    print "replayed messages: %s" % names
+
+    if len(names) < expected:
+        print >> sys.stderr, "expected at least %s messages, got %s" % (expected, len(names))
+        sys.exit(1)
+
+    head = os.readlink( "%s/head" % queue )
+    tail = os.readlink( "%s/tail" % queue )
+    print "head -> %s" % head
+    print "tail -> %s" % tail
+
+    with open("%s/head" % queue, "r") as f:
+        data = f.read()
+        if data != "0\n":
+            print >> sys.stderr, "head has '%s', expected '0'" % data.strip()
+            sys.exit(1)
+
+    for name in names:
+        with open("%s/%s" % (queue, name), "r") as f:
+            print "%s: %s" % (name, f.read().strip())
+
+    print "OK"
+
+else:
+    usage()
@@ -0,0 +1,116 @@
+#!/usr/bin/python
+
+# A leased directory lives for as long as its owner renews the lease, and goes away once it stops.
+# Run as root to also check that other users can neither renew nor take over a lease.
+
+import os
+import sys
+import time
+import errno
+import subprocess
+
+LEASE_SECS = 2
+RENEW_SECS = 6
+TIMEOUT = 10
+
+if len(sys.argv) < 2 or not os.path.exists( sys.argv[1] ):
+    print >> sys.stderr, "Usage: %s MOUNTPOINT" % sys.argv[0]
+    sys.exit(1)
+
+mountpoint = sys.argv[1]
+queue = "%s/test-lease" % mountpoint
+lease = "%s/.lease" % queue
+
+def touch( path ):
+    with open(path, "a") as f:
+        pass
+
+# run a function as nobody, and return the errno it failed with (0 if it succeeded)
+def as_nobody( func ):
+    pid = os.fork()
+    if pid == 0:
+        os.setgid(65534)
+        os.setuid(65534)
+        try:
+            func()
+            os._exit(0)
+        except (IOError, OSError) as e:
+            os._exit(e.errno)
+
+    _, status = os.waitpid( pid, 0 )
+    return os.WEXITSTATUS( status )
+
+# the creator puts the directory in lease mode and exits
+pid = os.fork()
+if pid == 0:
+    os.mkdir( queue )
+    os.chmod( queue, 0777 )
+    subprocess.check_call( ["setfattr", "-n", "user.eventfs_lease", "-v", str(LEASE_SECS), queue] )
+    touch( lease )
+    os._exit(0)
+
+os.waitpid( pid, 0 )
+
+# the owner (our uid) keeps it alive past its creator
+print "renewing %s for %s seconds" % (lease, RENEW_SECS)
+deadline = time.time() + RENEW_SECS
+while time.time() < deadline:
+
+    if not os.path.exists( queue ):
+        print >> sys.stderr, "%s expired while its lease was being renewed" % queue
+        sys.exit(1)
+
+    touch( lease )
+    time.sleep(0.5)
+
+if os.getuid() == 0:
+
+    # someone else can't renew it
+    rc = as_nobody( lambda: touch( lease ) )
+    if rc != errno.EPERM:
+        print >> sys.stderr, "non-owner renewal of %s: expected EPERM, got %s" % (lease, rc)
+        sys.exit(1)
+
+    print "non-owner renewal refused"
+
+# stop renewing; it should go away within a couple of lease lengths
+start = time.time()
+while time.time() < start + TIMEOUT and os.path.exists( queue ):
+    time.sleep(0.1)
+
+if os.path.exists( queue ):
+    print >> sys.stderr, "%s still exists %s seconds after its lease stopped being renewed" % (queue, TIMEOUT)
+    sys.exit(1)
+
+print "%s expired after %.3f seconds" % (queue, time.time() - start)
+
+# .lease is never charged to our quota, so removing it must not give anything back either.
+# if it did, our file count would wrap around, and every create after this would fail with EDQUOT.
+os.mkdir( queue )
+for i in xrange(0, 10):
+    touch( lease )
+    os.unlink( lease )
+
+with open("%s/msg" % queue, "w") as f:
+    f.write("hello\n")
+
+print "created a message after creating and removing %s 10 times" % lease
+
+os.unlink( "%s/msg" % queue )
+os.rmdir( queue )
+
+if os.getuid() == 0:
+
+    # someone else can't put our directory in lease mode
+    os.mkdir( queue )
+    os.chmod( queue, 0777 )
+
+    rc = as_nobody( lambda: touch( lease ) )
+    if rc != errno.EPERM:
+        print >> sys.stderr, "non-owner creation of %s: expected EPERM, got %s" % (lease, rc)
+        sys.exit(1)
+
+    print "non-owner lease creation refused"
+    os.rmdir( queue )
+
+print "OK"
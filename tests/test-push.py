@@ -0,0 +1,31 @@
+#!/usr/bin/python
+
+import os
+import sys
+import time
+
+NUM_EVENT_QUEUES = 1
+NUM_FILES = 10
+
+mountpoint = sys.argv[1]
+if not os.path.exists( mountpoint ):
+    print >> sys.stderr, "Usage: %s MOUNTPOINT" % sys.argv[0]
+    sys.exit(1)
+
+for i in xrange(0, NUM_EVENT_QUEUES):
+
+    print "event queue: %s/test-push-%s" % (mountpoint, i)
+    os.mkdir( "%s/test-push-%s" % (mountpoint, i) )
+
+    for j in xrange(0, NUM_FILES):
+        path = "%s/test-push-%s/.push" % (mountpoint, i)
+        print "event message: %s" % path
+
+        with open(path, "w") as f:
+            f.write("%s\n" % j)
+
+    print "tail -> %s" % os.readlink( "%s/test-push-%s/tail" % (mountpoint, i) )
+
+print "Waiting for SIGINT"
+while True:
+    time.sleep(100)
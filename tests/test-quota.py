@@ -0,0 +1,118 @@
+#!/usr/bin/python
+
+# A user at quota gets its dead directories back on the spot, instead of EDQUOT (or, for files, right after it).
+#
+# Run eventfs with `default_max_dirs` and `default_max_files` set (e.g. 4 and 16), and without the process
+# connector (e.g. unprivileged), so that nothing else reaps dead directories first.  Then:
+#   test-quota.py MOUNTPOINT MAX_DIRS MAX_FILES
+
+import os
+import sys
+import errno
+import time
+import subprocess
+
+if len(sys.argv) < 4 or not os.path.exists( sys.argv[1] ):
+    print >> sys.stderr, "Usage: %s MOUNTPOINT MAX_DIRS MAX_FILES" % sys.argv[0]
+    sys.exit(1)
+
+mountpoint = sys.argv[1]
+max_dirs = int(sys.argv[2])
+max_files = int(sys.argv[3])
+
+# have a child create a directory (and maybe some files in it), and exit
+def dead_dir( name, sticky=False, num_files=0 ):
+    pid = os.fork()
+    if pid == 0:
+        path = "%s/%s" % (mountpoint, name)
+        os.mkdir( path )
+        if sticky:
+            subprocess.check_call( ["setfattr", "-n", "user.eventfs_sticky", "-v", "1", path] )
+
+        for i in xrange(0, num_files):
+            with open("%s/%s" % (path, i), "w") as f:
+                f.write("%s\n" % i)
+
+        os._exit(0)
+
+    _, status = os.waitpid( pid, 0 )
+    if os.WEXITSTATUS( status ) != 0:
+        print >> sys.stderr, "child failed to create %s" % name
+        sys.exit(1)
+
+def expect_edquot( func, what ):
+    try:
+        func()
+    except (IOError, OSError) as e:
+        if e.errno == errno.EDQUOT:
+            print "%s: EDQUOT, as expected" % what
+            return
+
+        raise
+
+    print >> sys.stderr, "%s: expected EDQUOT" % what
+    sys.exit(1)
+
+# directory quota: fill it with dead directories, one of them sticky
+dead_dir( "test-quota-sticky", sticky=True )
+for i in xrange(0, max_dirs - 1):
+    dead_dir( "test-quota-dead-%s" % i )
+
+print "%s dead directories (1 sticky)" % max_dirs
+
+# every non-sticky dead one comes back
+live = []
+for i in xrange(0, max_dirs - 1):
+    path = "%s/test-quota-live-%s" % (mountpoint, i)
+    os.mkdir( path )
+    live.append( path )
+
+print "created %s directories after reclaiming" % len(live)
+
+# but the sticky one doesn't, so now we're really at quota
+expect_edquot( lambda: os.mkdir( "%s/test-quota-live-%s" % (mountpoint, max_dirs) ), "mkdir past quota" )
+
+if not os.path.exists( "%s/test-quota-sticky" % mountpoint ):
+    print >> sys.stderr, "sticky directory was reclaimed"
+    sys.exit(1)
+
+for path in live:
+    os.rmdir( path )
+
+os.rmdir( "%s/test-quota-sticky" % mountpoint )
+
+# file quota: a dead directory holds all of our files
+dead_dir( "test-quota-files", num_files=max_files )
+print "dead directory with %s files" % max_files
+
+path = "%s/test-quota-live" % mountpoint
+os.mkdir( path )
+
+# the first try kicks off the reclaim; the files come back in the background
+created = False
+for i in xrange(0, 100):
+    try:
+        with open("%s/0" % path, "w") as f:
+            f.write("0\n")
+
+        created = True
+        break
+    except (IOError, OSError) as e:
+        if e.errno != errno.EDQUOT:
+            raise
+
+        time.sleep(0.01)
+
+if not created:
+    print >> sys.stderr, "files were not reclaimed"
+    sys.exit(1)
+
+print "created a file after reclaiming"
+
+if os.path.exists( "%s/test-quota-files" % mountpoint ):
+    print >> sys.stderr, "dead directory was not reclaimed"
+    sys.exit(1)
+
+os.unlink( "%s/0" % path )
+os.rmdir( path )
+print "OK"
@@ -0,0 +1,346 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "timer.h"
+
+// get the current time, in ticks
+uint64_t eventfs_timer_now() {
+   
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   
+   return ((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000) / EVENTFS_TIMER_TICK_MS;
+}
+
+
+// set up a timer wheel, starting at the current time
+// return 0 on success 
+// return negative on failure to set up the lock
+int eventfs_timer_wheel_init( struct eventfs_timer_wheel* wheel ) {
+   
+   int rc = 0;
+   
+   memset( wheel, 0, sizeof(struct eventfs_timer_wheel) );
+   
+   rc = pthread_mutex_init( &wheel->lock, NULL );
+   if( rc != 0 ) {
+      return -abs(rc);
+   }
+   
+   wheel->now = eventfs_timer_now();
+   return 0;
+}
+
+
+// free a timer wheel.
+// the timers themselves belong to their owners, and are merely forgotten.
+int eventfs_timer_wheel_free( struct eventfs_timer_wheel* wheel ) {
+   
+   pthread_mutex_destroy( &wheel->lock );
+   memset( wheel, 0, sizeof(struct eventfs_timer_wheel) );
+   return 0;
+}
+
+
+// set up a timer 
+// always succeeds 
+int eventfs_timer_init( struct eventfs_timer* timer, eventfs_timer_func_t func, eventfs_timer_release_func_t release, void* cls ) {
+   
+   memset( timer, 0, sizeof(struct eventfs_timer) );
+   
+   timer->func = func;
+   timer->release = release;
+   timer->cls = cls;
+   return 0;
+}
+
+
+// put a timer into the slot that covers its expiry time.
+// timers due within EVENTFS_TIMER_SLOTS ticks go into level 0; further-out timers go into coarser levels, 
+// and get cascaded down as the wheel turns.
+// NOTE: wheel must be locked
+static void eventfs_timer_wheel_place( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer ) {
+   
+   uint64_t expires = timer->expires;
+   uint64_t delta = 0;
+   int level = 0;
+   int slot = 0;
+   
+   if( expires <= wheel->now ) {
+      
+      // overdue; fire on the next tick
+      expires = wheel->now + 1;
+   }
+   
+   delta = expires - wheel->now;
+   
+   while( level < EVENTFS_TIMER_LEVELS - 1 && delta >= ((uint64_t)1 << (EVENTFS_TIMER_SLOT_BITS * (level + 1))) ) {
+      level++;
+   }
+   
+   if( level == EVENTFS_TIMER_LEVELS - 1 && delta >= ((uint64_t)1 << (EVENTFS_TIMER_SLOT_BITS * EVENTFS_TIMER_LEVELS)) ) {
+      
+      // beyond the wheel's horizon.  Park it in the farthest slot; it will be re-placed when it cascades.
+      expires = wheel->now + ((uint64_t)1 << (EVENTFS_TIMER_SLOT_BITS * EVENTFS_TIMER_LEVELS)) - 1;
+   }
+   
+   slot = (expires >> (EVENTFS_TIMER_SLOT_BITS * level)) & EVENTFS_TIMER_SLOT_MASK;
+   
+   timer->prev = NULL;
+   timer->next = wheel->slots[level][slot];
+   
+   if( timer->next != NULL ) {
+      timer->next->prev = timer;
+   }
+   
+   wheel->slots[level][slot] = timer;
+   timer->level = level;
+   timer->slot = slot;
+   timer->pending = true;
+}
+
+
+// take a pending timer out of its slot 
+// NOTE: wheel must be locked
+static void eventfs_timer_wheel_unlink( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer ) {
+   
+   if( timer->prev != NULL ) {
+      timer->prev->next = timer->next;
+   }
+   else {
+      
+      // head of its slot
+      wheel->slots[timer->level][timer->slot] = timer->next;
+   }
+   
+   if( timer->next != NULL ) {
+      timer->next->prev = timer->prev;
+   }
+   
+   timer->prev = NULL;
+   timer->next = NULL;
+   timer->pending = false;
+}
+
+
+// schedule a timer to fire at the given tick, moving it if it is already scheduled.
+// if the timer is firing right now, it will be rescheduled once its callback returns.
+// return 0 on success
+// return -EINVAL if the timer was cancelled
+// NOTE: wheel must be locked
+static int eventfs_timer_schedule_locked( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer, uint64_t expires ) {
+   
+   if( timer->cancelled ) {
+      return -EINVAL;
+   }
+   
+   timer->expires = expires;
+   
+   if( timer->firing ) {
+      
+      timer->rearm = true;
+   }
+   else {
+      
+      if( timer->pending ) {
+         eventfs_timer_wheel_unlink( wheel, timer );
+      }
+      
+      eventfs_timer_wheel_place( wheel, timer );
+   }
+   
+   return 0;
+}
+
+
+// schedule a timer to fire at the given tick, moving it if it is already scheduled.
+// return 0 on success
+// return -EINVAL if the timer was cancelled
+int eventfs_timer_schedule( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer, uint64_t expires ) {
+   
+   int rc = 0;
+   
+   pthread_mutex_lock( &wheel->lock );
+   
+   rc = eventfs_timer_schedule_locked( wheel, timer, expires );
+   
+   pthread_mutex_unlock( &wheel->lock );
+   return rc;
+}
+
+
+// schedule a timer to fire at the given tick, unless it is already due to fire by then.
+// return 0 on success
+// return -EINVAL if the timer was cancelled
+int eventfs_timer_schedule_earliest( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer, uint64_t expires ) {
+   
+   int rc = 0;
+   
+   pthread_mutex_lock( &wheel->lock );
+   
+   if( !(timer->pending || timer->rearm) || timer->expires > expires ) {
+      
+      rc = eventfs_timer_schedule_locked( wheel, timer, expires );
+   }
+   
+   pthread_mutex_unlock( &wheel->lock );
+   return rc;
+}
+
+
+// cancel a timer.
+// return true if the caller may free the timer now
+// return false if the timer is firing; the wheel will call its release callback once it is done with it.
+bool eventfs_timer_cancel( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer ) {
+   
+   bool ret = true;
+   
+   pthread_mutex_lock( &wheel->lock );
+   
+   if( timer->firing ) {
+      
+      timer->cancelled = true;
+      timer->rearm = false;
+      ret = false;
+   }
+   else if( timer->pending ) {
+      
+      eventfs_timer_wheel_unlink( wheel, timer );
+   }
+   
+   pthread_mutex_unlock( &wheel->lock );
+   return ret;
+}
+
+
+// re-place every timer in a slot, now that the wheel has turned far enough that they belong in a finer level 
+// NOTE: wheel must be locked
+static void eventfs_timer_wheel_cascade( struct eventfs_timer_wheel* wheel, int level, int slot ) {
+   
+   struct eventfs_timer* itr = wheel->slots[level][slot];
+   struct eventfs_timer* next = NULL;
+   
+   wheel->slots[level][slot] = NULL;
+   
+   while( itr != NULL ) {
+      
+      next = itr->next;
+      eventfs_timer_wheel_place( wheel, itr );
+      itr = next;
+   }
+}
+
+
+// turn the wheel up to the given tick, and call every timer that expired along the way.
+// each expired timer costs O(1), plus O(1) per cascade it went through.
+// return 0 on success
+int eventfs_timer_wheel_advance( struct eventfs_timer_wheel* wheel, uint64_t now ) {
+   
+   int rc = 0;
+   struct eventfs_timer* expired = NULL;
+   struct eventfs_timer* itr = NULL;
+   struct eventfs_timer* next = NULL;
+   
+   pthread_mutex_lock( &wheel->lock );
+   
+   while( wheel->now < now ) {
+      
+      wheel->now++;
+      
+      // cascade coarser levels whose slot boundary we just crossed
+      for( int level = 1; level < EVENTFS_TIMER_LEVELS; level++ ) {
+         
+         if( (wheel->now & (((uint64_t)1 << (EVENTFS_TIMER_SLOT_BITS * level)) - 1)) != 0 ) {
+            break;
+         }
+         
+         eventfs_timer_wheel_cascade( wheel, level, (wheel->now >> (EVENTFS_TIMER_SLOT_BITS * level)) & EVENTFS_TIMER_SLOT_MASK );
+      }
+      
+      // collect this tick's timers
+      itr = wheel->slots[0][ wheel->now & EVENTFS_TIMER_SLOT_MASK ];
+      wheel->slots[0][ wheel->now & EVENTFS_TIMER_SLOT_MASK ] = NULL;
+      
+      while( itr != NULL ) {
+         
+         next = itr->next;
+         
+         if( itr->expires > wheel->now ) {
+            
+            // parked beyond the horizon; not due yet
+            eventfs_timer_wheel_place( wheel, itr );
+         }
+         else {
+            
+            itr->pending = false;
+            itr->firing = true;
+            itr->prev = NULL;
+            itr->next = expired;
+            expired = itr;
+         }
+         
+         itr = next;
+      }
+   }
+   
+   pthread_mutex_unlock( &wheel->lock );
+   
+   // fire!
+   // NOTE: no one else touches a firing timer's links 
+   while( expired != NULL ) {
+      
+      itr = expired;
+      expired = expired->next;
+      
+      itr->next = NULL;
+      
+      rc = (*itr->func)( itr, itr->cls );
+      if( rc != 0 ) {
+         
+         eventfs_error("timer %p rc = %d\n", itr, rc );
+      }
+      
+      pthread_mutex_lock( &wheel->lock );
+      
+      itr->firing = false;
+      
+      if( itr->cancelled ) {
+         
+         pthread_mutex_unlock( &wheel->lock );
+         
+         if( itr->release != NULL ) {
+            (*itr->release)( itr, itr->cls );
+         }
+         
+         continue;
+      }
+      
+      if( itr->rearm ) {
+         
+         itr->rearm = false;
+         eventfs_timer_wheel_place( wheel, itr );
+      }
+      
+      pthread_mutex_unlock( &wheel->lock );
+   }
+   
+   return 0;
+}
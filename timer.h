@@ -0,0 +1,87 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _EVENTFS_TIMER_H_
+#define _EVENTFS_TIMER_H_
+
+#include "os.h"
+#include "util.h"
+
+// hierarchical timer wheel geometry.
+// each level has EVENTFS_TIMER_SLOTS slots, and each slot at level i spans EVENTFS_TIMER_SLOTS^i ticks.
+#define EVENTFS_TIMER_LEVELS        4
+#define EVENTFS_TIMER_SLOT_BITS     6
+#define EVENTFS_TIMER_SLOTS         (1 << EVENTFS_TIMER_SLOT_BITS)
+#define EVENTFS_TIMER_SLOT_MASK     (EVENTFS_TIMER_SLOTS - 1)
+
+// length of a tick
+#define EVENTFS_TIMER_TICK_MS       1000
+
+struct eventfs_timer;
+
+// timer callback type.  Called without the wheel locked.
+typedef int (*eventfs_timer_func_t)( struct eventfs_timer* timer, void* cls );
+
+// timer release callback type.  Called once the wheel is done with a timer that was cancelled while firing.
+typedef void (*eventfs_timer_release_func_t)( struct eventfs_timer* timer, void* cls );
+
+// a timer.  The owner allocates it; the wheel only links it in.
+struct eventfs_timer {
+   
+   uint64_t expires;                    // absolute tick at which to fire
+   
+   eventfs_timer_func_t func;
+   eventfs_timer_release_func_t release;
+   void* cls;
+   
+   bool pending;                        // if true, then the timer is in a slot
+   bool firing;                         // if true, then the wheel has taken it out of its slot to call func
+   bool rearm;                          // if true, then the timer was rescheduled while firing
+   bool cancelled;                      // if true, then the owner gave it up while it was firing
+   
+   int level;                           // where it is, if pending
+   int slot;
+   
+   struct eventfs_timer* prev;
+   struct eventfs_timer* next;
+};
+
+// a hierarchical timer wheel 
+struct eventfs_timer_wheel {
+   
+   pthread_mutex_t lock;
+   
+   uint64_t now;                        // last tick processed
+   struct eventfs_timer* slots[EVENTFS_TIMER_LEVELS][EVENTFS_TIMER_SLOTS];
+};
+
+uint64_t eventfs_timer_now();
+
+int eventfs_timer_wheel_init( struct eventfs_timer_wheel* wheel );
+int eventfs_timer_wheel_free( struct eventfs_timer_wheel* wheel );
+int eventfs_timer_wheel_advance( struct eventfs_timer_wheel* wheel, uint64_t now );
+
+int eventfs_timer_init( struct eventfs_timer* timer, eventfs_timer_func_t func, eventfs_timer_release_func_t release, void* cls );
+int eventfs_timer_schedule( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer, uint64_t expires );
+int eventfs_timer_schedule_earliest( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer, uint64_t expires );
+bool eventfs_timer_cancel( struct eventfs_timer_wheel* wheel, struct eventfs_timer* timer );
+
+#endif
@@ -0,0 +1,233 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "ttl.h"
+#include "eventfs.h"
+
+// get the TTL (in seconds) set on an entry 
+// return the TTL on success
+// return 0 if there is no (valid) TTL
+static uint64_t eventfs_ttl_get( struct fskit_core* core, char const* path, struct fskit_entry* fent ) {
+   
+   int rc = 0;
+   char buf[EVENTFS_TTL_BUF_LEN+1];
+   char* tmp = NULL;
+   uint64_t ttl = 0;
+   
+   memset( buf, 0, EVENTFS_TTL_BUF_LEN+1 );
+   
+   rc = fskit_fgetxattr( core, path, fent, EVENTFS_XATTR_TTL, buf, EVENTFS_TTL_BUF_LEN );
+   if( rc <= 0 ) {
+      return 0;
+   }
+   
+   ttl = (uint64_t)strtoull( buf, &tmp, 10 );
+   if( tmp == buf || (*tmp != '\0' && *tmp != '\n') ) {
+      
+      eventfs_error("Invalid %s '%s' on '%s'\n", EVENTFS_XATTR_TTL, buf, path );
+      return 0;
+   }
+   
+   return ttl;
+}
+
+
+// free a TTL timer once the wheel is done with it
+static void eventfs_ttl_free( struct eventfs_timer* timer, void* cls ) {
+   
+   struct eventfs_ttl* ttl = (struct eventfs_ttl*)cls;
+   
+   eventfs_safe_free( ttl->dir_path );
+   eventfs_safe_free( ttl );
+}
+
+
+// expire the directory's messages, oldest first, up to the first one that is still live.
+// then wait for that one.
+// runs on the deferred work queue, from the timer wheel.
+// return 0 on success, even if the directory is gone 
+static int eventfs_ttl_expire( struct eventfs_timer* timer, void* cls ) {
+   
+   int rc = 0;
+   struct eventfs_ttl* ttl = (struct eventfs_ttl*)cls;
+   struct eventfs_state* eventfs = ttl->eventfs;
+   struct fskit_entry* dent = NULL;
+   struct eventfs_dir_inode* dir = NULL;
+   struct eventfs_file_deque* old_head = NULL;
+   uint64_t now = eventfs_timer_now();
+   
+   dent = fskit_entry_resolve_path( eventfs->core, ttl->dir_path, 0, 0, true, &rc );
+   if( dent == NULL ) {
+      
+      // directory is gone; it will release this timer
+      return 0;
+   }
+   
+   dir = (struct eventfs_dir_inode*)fskit_entry_get_user_data( dent );
+   if( dir == NULL || dir != ttl->dir || dir->ttl != ttl || dir->deleted ) {
+      
+      // not our directory anymore
+      fskit_entry_unlock( dent );
+      return 0;
+   }
+   
+   while( dir->head != NULL && dir->head->expires != 0 && dir->head->expires <= now ) {
+      
+      eventfs_debug("expire '%s/%s'\n", ttl->dir_path, dir->head->name );
+      
+      old_head = dir->head;
+      
+      rc = eventfs_dir_inode_pophead( eventfs->core, ttl->dir_path, dir, dent );
+      if( rc != 0 ) {
+         
+         eventfs_error("eventfs_dir_inode_pophead('%s') rc = %d\n", ttl->dir_path, rc );
+         break;
+      }
+      
+      if( dir->head == old_head ) {
+         
+         // someone has it open, so it was detached but not destroyed.  Drop it from the deque anyway.
+         rc = eventfs_dir_inode_remove( eventfs->core, ttl->dir_path, dir, dent, old_head->name );
+         if( rc != 0 ) {
+            
+            eventfs_error("eventfs_dir_inode_remove('%s') rc = %d\n", ttl->dir_path, rc );
+            break;
+         }
+      }
+   }
+   
+   if( rc != 0 ) {
+      
+      // try again next tick
+      eventfs_timer_schedule( &eventfs->timers, timer, now + 1 );
+   }
+   else if( dir->head != NULL && dir->head->expires != 0 ) {
+      
+      // wait for the next-oldest 
+      eventfs_timer_schedule( &eventfs->timers, timer, dir->head->expires );
+   }
+   
+   fskit_entry_unlock( dent );
+   return rc;
+}
+
+
+// give the newest message in a directory its expiry time, and make sure the directory's timer will fire for it.
+// the message's own TTL takes precedence over the directory's.  msg and msg_path may be NULL.
+// return 0 on success, including if there is no TTL
+// return -ENOMEM on OOM 
+// NOTE: dent must be write-locked, msg must not be locked, and the message must have just been appended
+int eventfs_ttl_arm( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* dent, struct eventfs_dir_inode* dir, char const* msg_path, struct fskit_entry* msg ) {
+   
+   uint64_t ttl_secs = 0;
+   uint64_t expires = 0;
+   struct eventfs_ttl* ttl = NULL;
+   
+   if( dir->tail == NULL ) {
+      return 0;
+   }
+   
+   if( msg != NULL ) {
+      
+      fskit_entry_rlock( msg );
+      ttl_secs = eventfs_ttl_get( eventfs->core, msg_path, msg );
+      fskit_entry_unlock( msg );
+   }
+   
+   if( ttl_secs == 0 ) {
+      ttl_secs = eventfs_ttl_get( eventfs->core, dir_path, dent );
+   }
+   
+   if( ttl_secs == 0 ) {
+      
+      // lives until consumed 
+      return 0;
+   }
+   
+   expires = eventfs_timer_now() + (ttl_secs * 1000 + EVENTFS_TIMER_TICK_MS - 1) / EVENTFS_TIMER_TICK_MS;
+   
+   // messages expire in FIFO order, so a short TTL can't overtake the message ahead of it
+   if( dir->tail->prev != NULL && dir->tail->prev->expires > expires ) {
+      expires = dir->tail->prev->expires;
+   }
+   
+   dir->tail->expires = expires;
+   
+   if( dir->ttl == NULL ) {
+      
+      ttl = EVENTFS_CALLOC( struct eventfs_ttl, 1 );
+      if( ttl == NULL ) {
+         
+         dir->tail->expires = 0;
+         return -ENOMEM;
+      }
+      
+      ttl->dir_path = strdup( dir_path );
+      if( ttl->dir_path == NULL ) {
+         
+         eventfs_safe_free( ttl );
+         dir->tail->expires = 0;
+         return -ENOMEM;
+      }
+      
+      ttl->eventfs = eventfs;
+      ttl->dir = dir;
+      eventfs_timer_init( &ttl->timer, eventfs_ttl_expire, eventfs_ttl_free, ttl );
+      
+      dir->ttl = ttl;
+   }
+   
+   return eventfs_ttl_rearm( eventfs, dir );
+}
+
+
+// make sure a directory's expiry timer fires for its head.
+// a head without a TTL holds back expiry until it is consumed, at which point this gets called again.
+// return 0 on success, including if nothing needs to expire
+// NOTE: the directory must be write-locked
+int eventfs_ttl_rearm( struct eventfs_state* eventfs, struct eventfs_dir_inode* dir ) {
+   
+   if( dir->ttl == NULL || dir->head == NULL || dir->head->expires == 0 ) {
+      return 0;
+   }
+   
+   return eventfs_timer_schedule_earliest( &eventfs->timers, &dir->ttl->timer, dir->head->expires );
+}
+
+
+// stop and release a directory's expiry timer 
+// always succeeds
+// NOTE: the directory must be write-locked, or unreachable
+int eventfs_ttl_release( struct eventfs_state* eventfs, struct eventfs_dir_inode* dir ) {
+   
+   if( dir->ttl == NULL ) {
+      return 0;
+   }
+   
+   if( eventfs_timer_cancel( &eventfs->timers, &dir->ttl->timer ) ) {
+      
+      eventfs_ttl_free( &dir->ttl->timer, dir->ttl );
+   }
+   
+   // otherwise, it's firing, and will be freed once it's done
+   dir->ttl = NULL;
+   return 0;
+}
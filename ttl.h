@@ -0,0 +1,52 @@
+/*
+   eventfs: a self-cleaning filesystem for event queues.
+   Copyright (C) 2015  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _EVENTFS_TTL_H_
+#define _EVENTFS_TTL_H_
+
+#include "os.h"
+#include "util.h"
+#include "timer.h"
+
+// xattr (on a directory or a staged message) that gives a message's time-to-live, in seconds
+#define EVENTFS_XATTR_TTL         "user.eventfs_ttl"
+
+// longest TTL value we parse
+#define EVENTFS_TTL_BUF_LEN       32
+
+struct eventfs_state;
+struct eventfs_dir_inode;
+
+// a directory's expiry timer.
+// it always fires for the directory's oldest expiring message, so expiry never scans the deque.
+struct eventfs_ttl {
+   
+   struct eventfs_timer timer;
+   struct eventfs_state* eventfs;
+   struct eventfs_dir_inode* dir;       // only compared against, never dereferenced without the directory locked
+   char* dir_path;
+};
+
+int eventfs_ttl_arm( struct eventfs_state* eventfs, char const* dir_path, struct fskit_entry* dent, struct eventfs_dir_inode* dir, char const* msg_path, struct fskit_entry* msg );
+int eventfs_ttl_rearm( struct eventfs_state* eventfs, struct eventfs_dir_inode* dir );
+int eventfs_ttl_release( struct eventfs_state* eventfs, struct eventfs_dir_inode* dir );
+
+#endif
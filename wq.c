@@ -21,6 +21,30 @@
 
 #include "wq.h"
 
+// get the absolute time interval_ms from now
+static void eventfs_wq_deadline( int interval_ms, struct timespec* deadline ) {
+   
+   clock_gettime( CLOCK_REALTIME, deadline );
+   
+   deadline->tv_sec += interval_ms / 1000;
+   deadline->tv_nsec += (long)(interval_ms % 1000) * 1000000L;
+   
+   if( deadline->tv_nsec >= 1000000000L ) {
+      
+      deadline->tv_sec++;
+      deadline->tv_nsec -= 1000000000L;
+   }
+}
+
+// is deadline in the past?
+static bool eventfs_wq_deadline_passed( struct timespec* deadline ) {
+   
+   struct timespec now;
+   clock_gettime( CLOCK_REALTIME, &now );
+   
+   return (now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec));
+}
+
 // work queue main method
 static void* eventfs_wq_main( void* cls ) {
    
@@ -28,11 +52,28 @@ static void* eventfs_wq_main( void* cls ) {
    
    struct eventfs_wreq* work_itr = NULL;
    struct eventfs_wreq* next = NULL;
+   struct timespec next_tick;
    
    int rc = 0;
+   
+   if( wq->tick != NULL ) {
+      eventfs_wq_deadline( wq->tick_interval_ms, &next_tick );
+   }
 
    while( wq->running ) {
 
+      // time to tick?
+      if( wq->tick != NULL && eventfs_wq_deadline_passed( &next_tick ) ) {
+         
+         rc = (*wq->tick)( NULL, wq->tick_data );
+         if( rc != 0 ) {
+            
+            eventfs_error("tick %p rc = %d\n", wq->tick, rc );
+         }
+         
+         eventfs_wq_deadline( wq->tick_interval_ms, &next_tick );
+      }
+      
       // is there work?
       rc = sem_trywait( &wq->work_sem );
       if( rc != 0 ) {
@@ -40,8 +81,20 @@ static void* eventfs_wq_main( void* cls ) {
          rc = -errno;
          if( rc == -EAGAIN ) {
             
-            // wait for work
-            sem_wait( &wq->work_sem );
+            // wait for work (or the next tick)
+            if( wq->tick != NULL ) {
+               
+               rc = sem_timedwait( &wq->work_sem, &next_tick );
+               if( rc != 0 ) {
+                  
+                  // timed out or interrupted; go tick
+                  continue;
+               }
+            }
+            else {
+               
+               sem_wait( &wq->work_sem );
+            }
          }
          else {
             
@@ -213,6 +266,22 @@ int eventfs_wq_free( struct eventfs_wq* wq ) {
    return 0;
 }
 
+// have the work queue call tick every interval_ms milliseconds, in between work requests.
+// tick gets called with a NULL work request.
+// return 0 on success
+// return -EINVAL if already started
+int eventfs_wq_set_tick( struct eventfs_wq* wq, int interval_ms, eventfs_wq_func_t tick, void* tick_data ) {
+   
+   if( wq->running ) {
+      return -EINVAL;
+   }
+   
+   wq->tick = tick;
+   wq->tick_data = tick_data;
+   wq->tick_interval_ms = interval_ms;
+   return 0;
+}
+
 // create a work request
 // always succeeds
 int eventfs_wreq_init( struct eventfs_wreq* wreq, eventfs_wq_func_t work, void* work_data ) {
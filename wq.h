@@ -60,6 +60,11 @@ struct eventfs_wq {
 
    // semaphore to signal the availability of work
    sem_t work_sem;
+   
+   // (optional) periodic callback, run between work items
+   eventfs_wq_func_t tick;
+   void* tick_data;
+   int tick_interval_ms;
 };
 
 struct eventfs_wq* eventfs_wq_new();
@@ -67,6 +72,7 @@ int eventfs_wq_init( struct eventfs_wq* wq );
 int eventfs_wq_start( struct eventfs_wq* wq );
 int eventfs_wq_stop( struct eventfs_wq* wq );
 int eventfs_wq_free( struct eventfs_wq* wq );
+int eventfs_wq_set_tick( struct eventfs_wq* wq, int interval_ms, eventfs_wq_func_t tick, void* tick_data );
 
 int eventfs_wreq_init( struct eventfs_wreq* wreq, eventfs_wq_func_t work, void* work_data );
 int eventfs_wreq_free( struct eventfs_wreq* wreq );